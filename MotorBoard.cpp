@@ -1,6 +1,7 @@
 #include "config.h"
 #include <avr/io.h>
-#include <util/delay.h>
+#include <avr/eeprom.h>
+#include <util/atomic.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -9,25 +10,117 @@
 #include "pin.h"
 #include "bldc.h"
 #include "CanISR.h"
+#include "fixed.h"
+#include "speedctrl.h"
+#include "speedobs.h"
+#include "timebase.h"
+#include "current.h"
+#include "canrx.h"
+#include "telemetry.h"
+#include "canrtr.h"
+#include "sched.h"
+#include "mailbox.h"
+#include "profile.h"
+#include "trace.h"
 
 
 
 /*** USEFUL CONSTANTS ***/
 #define PI2                 6.28319     //          The 2PI constant
-#define ACCEL_REFRESH_HZ    100         // [Hz]     Board refresh frequency (using timer1 interrupts)
-#define SPEED_REFRESH_HZ	20	        // [Hz]     The speed observer refresh rate
+#define ACCEL_REFRESH_HZ    100         // [Hz]     Control rate (scheduler task, integer divider of SCHED_TICK_HZ)
+#define SPEED_REFRESH_HZ	20	        // [Hz]     The legacy speed frame rate (the speed observer is refreshed with the control)
+#define HOUSEKEEPING_HZ     100         // [Hz]     Boot sequence and LEDs rate
+#define DIAGNOSTICS_HZ      10          // [Hz]     Diagnostics frame rate (ENABLE_PROFILING, load window shorter than 262ms)
+#define TRACE_DUMP_HZ       100         // [Hz]     Trace dump rate
+#define TRACE_DUMP_FRAMES   2           //          Trace frames enqueued per dump task, while the transmit queue is at most half full
+#define TELEMETRY_HZ        20          // [Hz]     Default telemetry rate (integer divider of ACCEL_REFRESH_HZ)
 #define TICKS_TO_ROUNDS		48	        // [ticks]  Number of ticks for one round
+#define TASK_CONTROL        0           //          Index of the control task in the task table
+#define BOOT_BLINKS         4           //          Number of LED blinks at boot (non-blocking)
+#define BOOT_BLINK_MS       50          // [ms]     LED on/off delay of the boot blinks
 
 /*** MOTOR CONSTANTS ***/
 #define M_SPEEDCONST    	0.0330 	    // [V.s]    The motor speed constant used by the controller
 #define M_VOLTAGE		    12	        // [V]      The supplied voltage
 
+/*** SPEED CONTROLLER (default gains, can be tuned at runtime through CAN_ID_PARAM) ***/
+#define PI_KP               2.0         // [PWM.s.rad-1]    Proportional gain
+#define PI_KI               20.0        // [PWM.rad-1]      Integral gain
+#define PI_KAW              0.5         // []               Back-calculation anti-windup gain [0,1]
+
+/*** CURRENT CONTROLLER (CONTROL_CURRENT_LOOP, runs once per PWM cycle) ***/
+#define CURRENT_KP          0.5         // [PWM.LSB-1]      Proportional gain
+#define CURRENT_KI          0.05        // [PWM.LSB-1]      Integral gain per PWM cycle
+#define CURRENT_LIMIT       400         // [ADC LSB]        Current command bound
+
 /*** PWM COMMAND ***/
-#define VOLTS_TO_PWM_RATIO	2048/M_VOLTAGE	    //  The constant used to voltage to PWM value [-2048,2048]
+#define VOLTS_TO_PWM_RATIO  (BLDC_DUTY_MAX/M_VOLTAGE)               // [PWM.V-1]  Voltage to PWM value, [-BLDC_DUTY_MAX,BLDC_DUTY_MAX]
+#define SPEED_TO_PWM        (VOLTS_TO_PWM_RATIO * M_SPEEDCONST)     // [s.rad-1]  Speed command to PWM value gain
+#define SPEED_CMD_MAX_RADS  (BLDC_DUTY_MAX/SPEED_TO_PWM)            // [rad.s-1]  Speed command saturating the PWM
+
+/*** FIXED-POINT CONSTANTS ***/
+// Error bound against the float chain : |voltage_cmd_pwm(fixed) - voltage_cmd_pwm(float)| <= 1
+// (the product error is below 2^-8*SPEED_TO_PWM + 2^-11*SPEED_CMD_MAX_RADS = 0.2 before truncation)
+#if CONTROL_FIXED_POINT
+#define SPEED_TO_PWM_Q10    Q_FROM_CONST(SPEED_TO_PWM,10)                           // Q6.10
+#define SPEED_CMD_MAX_Q16   Q16_FROM_CONST(SPEED_CMD_MAX_RADS)                      // Q16.16
+#endif
+#define SPEED_EDGE_GAIN_Q16 Q16_FROM_CONST(PI2/TICKS_TO_ROUNDS*TIMEBASE_HZ)         // Q16.16 [rad x timebase Hz] Hall edge to speed
 
 /*** CAN IDs & MObs ***/
-#define CAN_ID_SPEED  		0x30
-#define CAN_ID_ACCEL		0x10
+// The frames sent by the board are on their base identifier + node index (one identifier per board, no collision)
+#define CAN_ID_TELEMETRY    0x20        // Packed telemetry (see telemetry.h)
+#define CAN_ID_SPEED        0x30        // Legacy speed frame (float), enabled by default, PARAM_LEGACY_SPEED turns it off
+#define CAN_ID_STATUS       0x40        // Boot status : | reset cause (MCUSR) | time to first control tick [4us] (uint16) |
+#define CAN_ID_SNAPSHOT     0x50        // SYNC snapshot : | position [ticks] (int32) | speed [1/64 rad.s-1] (int16) | speed age [4us] (uint16) |
+#define CAN_ID_DIAGNOSTICS  0x60        // Interrupt profiling (ENABLE_PROFILING, see profile.h)
+#define CAN_ID_TRACE_HEADER 0x70        // Trace dump header (see trace.h)
+#define CAN_ID_TRACE_RECORD 0x90        // Trace dump records
+#define CAN_ID_SYNC         0x80        // SYNC (any DLC), received by MOb2, handled in the CAN interrupt
+#define CAN_ID_ACCEL        0x10
+#define CAN_ID_PARAM        0x11
+#define CAN_ID_GROUP_FIRST  0x18        // Group acceleration commands : 0x18 + node index / 4
+#define CAN_ID_GROUP_LAST   0x1B
+#define CAN_ID_CMD_FIRST    0x10        // Command band received by MOb1 (0x10 to 0x1F)
+#define CAN_ID_CMD_SIZE     0x10
+#define CAN_ID_RTR_FIRST    0x200       // Objects answered on remote frames, 0x200 + 8 x node index + object, received by MOb3
+#define CAN_ID_RTR_SIZE     8           //          Identifiers per node (MOb3 band, power of 2, at least CANRTR_NB_OBJECTS)
+#define CAN_ID_RTR(node)    (CAN_ID_RTR_FIRST + (node) * CAN_ID_RTR_SIZE)
+
+/*** REMOTE OBJECTS (remote frame on CAN_ID_RTR(node index) + object, answered from a snapshot refreshed by the control task) ***/
+#define RTR_POSITION        0           // | position [ticks] (int32) | speed [1/64 rad.s-1] (int16) | snapshot time [4us] (uint16) |
+#define RTR_SPEED           1           // | speed (int16) | speed command (int16) [1/64 rad.s-1] | voltage command [PWM] (int16) | status (uint8) |
+#define RTR_ERRORS          2           // | CAN tx dropped (uint16) | CAN tx overruns (uint16) | CAN rx overruns (uint16) | bus-off (uint8) | reset cause (uint8) |
+#define RTR_LOOP_STATS      3           // | last control time (uint16) | longest control time since boot (uint16) | boot time (uint16) [4us] | CAN tx max level (uint8) | control overruns (uint8) |
+#define RTR_PARAMS          4           // | kp | ki | kaw (int16 Q6.10) | flags (uint8) | telemetry rate [Hz] (uint8) |
+#define RTR_FLAG_SINE       0x01        //          RTR_PARAMS flags : sinusoidal drive
+#define RTR_FLAG_ADVANCE    0x02        //          phase advance
+#define RTR_FLAG_LEGACY     0x04        //          legacy speed frame
+#define RTR_FLAG_REALIGN    0x08        //          SYNC realignment
+#define RTR_FLAG_NODE_SHIFT 4           //          node index in the 4 high bits
+
+/*** GROUP COMMAND (CAN_ID_GROUP_FIRST + group frame : 4 x int16 accelerations, slot = node index % 4) ***/
+#define GROUP_NODES         4           //          Number of slots in a group frame
+#define GROUP_ACCEL_BITS    4           //          Acceleration resolution 1/16 rad.s-2 (range +-2048 rad.s-2)
+#define GROUP_SLOT_NONE     INT16_MIN   //          Slot value without command (the node keeps its acceleration)
+#define NODE_INDEX_MAX      15          //          Node index range [0, 15] (4 group frames)
+
+/*** PARAMETERS (CAN_ID_PARAM frame : | key | value LSB | value MSB |) ***/
+#define PARAM_KP            0x00        // Proportional gain            Q6.10 [PWM.s.rad-1]
+#define PARAM_KI            0x01        // Integral gain per period     Q6.10 [PWM.rad-1]
+#define PARAM_KAW           0x02        // Anti-windup gain             Q6.10
+#define PARAM_DRIVE_MODE    0x03        // Drive mode                   BLDC_DRIVE_SIXSTEP (0) or BLDC_DRIVE_SINE (1)
+#define PARAM_PHASE_ADVANCE 0x04        // Phase advance                0 (disabled) or 1 (enabled)
+#define PARAM_CURRENT_KP    0x05        // Current proportional gain    Q6.10 [PWM.LSB-1]
+#define PARAM_CURRENT_KI    0x06        // Current integral gain        Q6.10 [PWM.LSB-1] per PWM cycle
+#define PARAM_TELEMETRY_HZ  0x07        // Telemetry rate               [Hz] 0 (disabled) to ACCEL_REFRESH_HZ
+#define PARAM_LEGACY_SPEED  0x08        // Legacy speed frame           0 (disabled) or 1 (enabled, 20Hz, default)
+#define PARAM_NODE_INDEX    0x09        // Node index (group command)   [0, NODE_INDEX_MAX], stored in EEPROM
+#define PARAM_SYNC_REALIGN  0x0A        // SYNC realigns the schedule   0 (disabled) or 1 (the control runs one scheduler tick after SYNC)
+#define PARAM_TRACE_ARM     0x0B        // Trace                        Trigger sources and options (TRACE_TRIGGER_..., TRACE_EDGES), 0 stops
+#define PARAM_TRACE_POST    0x0C        // Trace records after trigger  [0, TRACE_SIZE-1], applied by the next PARAM_TRACE_ARM
+#define PARAM_TRACE_TRIGGER 0x0D        // Trace trigger                Any value
+#define PARAM_PWM_FREQUENCY 0x0E        // Switching frequency          [10Hz] 1 to 32767 (10Hz to 327.67kHz) solved at runtime, dead time PWM_DEADTIME_NS
 
 
 
@@ -36,108 +129,496 @@ LED red_led(&LED_RED_PORT, LED_RED_PIN, LED_RED_POL);
 LED yellow_led(&LED_YELLOW_PORT, LED_YELLOW_PIN, LED_YELLOW_POL);
 
 /** GLOBAL VARIABLES **/
-int16_t voltage_cmd_pwm;    // [-2048, 2048] PWM value to encode the voltage : [-M_VOLTAGE, M_VOLTAGE]
+int16_t voltage_cmd_pwm;    // [-BLDC_DUTY_MAX, BLDC_DUTY_MAX] PWM value to encode the voltage : [-M_VOLTAGE, M_VOLTAGE]
+                            // (current command [ADC LSB] when the current loop is enabled)
+#if CONTROL_FIXED_POINT
+q16_t accel_step_q16;       // [rad.s-1]    The acceleration command integrated over one timer1 period (Q16.16)
+q16_t speed_cmd_q16;        // [rad.s-1]    The speed command (Q16.16, refreshed every control task to achieve the accel cmd)
+q16_t speed_q16;            // [rad.s-1]    The actual motor speed (Q16.16, refreshed every control task)
+#else
 float accel_cmd_radss;	    // [rad.s-2]    The acceleration command (received from the CAN bus)
-float speed_cmd_rads;	    // [rad.s-1]    The speed command (refreshed every timer1 int. to achieve the accel cmd)
-float speed_rads;	        // [rad.s-1]    The actual motor speed
-int64_t position;	        // [ticks]	    The actual motor position
+float speed_cmd_rads;	    // [rad.s-1]    The speed command (refreshed every control task to achieve the accel cmd)
+float speed_rads;	        // [rad.s-1]    The actual motor speed (refreshed every control task)
+#endif
+
+volatile bool motor_ready;  // The PWM is running (PLL locked), the control task commands the motor
+volatile bool boot_tick;    // The first control tick commanding the motor is done
+uint16_t boot_tick_time;    // [4us]        Time from the timebase start to the first control tick
+volatile bool legacy_speed; // Send the legacy speed frame (CAN_ID_SPEED)
+uint16_t control_time_max;  // [4us]        Longest control task since the last telemetry frame
+uint16_t can_tx_dropped;    //              CAN transmit drops at the last telemetry frame
+uint16_t can_rx_overruns;   //              CAN receive overruns at the last telemetry frame
+uint8_t telemetry_buff[8];  // The CAN buffer used to send the telemetry
+volatile uint8_t node_index; // Slot of this board in the group command frames, SYNC snapshot and remote object identifiers
+volatile bool node_index_pending; // The node index changed, saved in EEPROM by the housekeeping task
+volatile bool sync_realign; // The SYNC frame realigns the schedule (control phase)
+mailbox_double<uint16_t> control_tick_time; // [4us] Start of the last control task (age of the speed estimate, read by the SYNC handler)
+uint8_t snapshot_buff[8];   // The CAN buffer used to send the SYNC snapshot
+uint8_t reset_cause;        // MCUSR at boot
+bool status_sent;           // The boot status frame is sent
+uint16_t control_time_last; // [4us]        Duration of the last control task
+uint16_t control_time_peak; // [4us]        Longest control task since boot
+uint8_t rtr_buff[8];        // The buffer used to refresh the remote objects
+uint8_t trace_buff[8];      // The CAN buffer used to dump the trace
+uint8_t hall_errors;        // Hall errors at the last control task (trace trigger)
+#if ENABLE_PROFILING
+uint8_t diagnostics_buff[8]; // The CAN buffer used to send the interrupt profiling
+#endif
+uint8_t EEMEM node_index_eeprom = 0;  // Node index kept across resets (0xFF : erased, index 0)
 
 uint8_t can_buff[8];	    // The CAN buffer used to send data
-uint8_t accel_buff[8];	    // The CAN buffer received to set acceleration
+
+
+
+/** STATUS & REMOTE OBJECTS **/
+uint8_t controlStatus() {
+    // Status bits of the control (TELEMETRY_STATUS_..., without the CAN bits, the hall error is not reset)
+    uint8_t status = TELEMETRY_STATUS_READY;
+    if (hall_getError()) status |= TELEMETRY_STATUS_HALL_ERROR;
+    if (bldc_getDriveMode() == BLDC_DRIVE_SINE) status |= TELEMETRY_STATUS_SINE;
+    if (bldc_getPhaseAdvance()) status |= TELEMETRY_STATUS_ADVANCE;
+    if (bldc_isSensorless()) status |= TELEMETRY_STATUS_SENSORLESS;
+    if (speedctrl_isSaturated()) status |= TELEMETRY_STATUS_SATURATED;
+    return status;
+}
+
+void updateParamObject() {
+    // Refreshed when a parameter changes
+    int16_t gains[3] = { speedctrl_getKp(), speedctrl_getKi(), speedctrl_getKaw() };
+    memcpy(&rtr_buff[0], gains, sizeof(gains));
+    uint8_t flags = node_index << RTR_FLAG_NODE_SHIFT;
+    if (bldc_getDriveMode() == BLDC_DRIVE_SINE) flags |= RTR_FLAG_SINE;
+    if (bldc_getPhaseAdvance()) flags |= RTR_FLAG_ADVANCE;
+    if (legacy_speed) flags |= RTR_FLAG_LEGACY;
+    if (sync_realign) flags |= RTR_FLAG_REALIGN;
+    rtr_buff[6] = flags;
+    rtr_buff[7] = telemetry_getRate();
+    canrtr_update(RTR_PARAMS, 8, rtr_buff);
+}
+
+void updateControlObjects(q16_t speed, q16_t speed_cmd) {
+    // Refreshed by each control tick
+    int32_t position = hall_getPosition32();
+    int16_t speed_frame = telemetry_speed(speed);
+    memcpy(&rtr_buff[0], &position, sizeof(int32_t));
+    memcpy(&rtr_buff[4], &speed_frame, sizeof(int16_t));
+    uint16_t snapshot_time = control_tick_time.read();
+    memcpy(&rtr_buff[6], &snapshot_time, sizeof(uint16_t));
+    canrtr_update(RTR_POSITION, 8, rtr_buff);
+
+    int16_t speed_cmd_frame = telemetry_speed(speed_cmd);
+    memcpy(&rtr_buff[0], &speed_frame, sizeof(int16_t));
+    memcpy(&rtr_buff[2], &speed_cmd_frame, sizeof(int16_t));
+    memcpy(&rtr_buff[4], &voltage_cmd_pwm, sizeof(int16_t));
+    rtr_buff[6] = controlStatus();
+    canrtr_update(RTR_SPEED, 7, rtr_buff);
+
+    cantx_stats_t tx_stats;
+    cantx_getStats(&tx_stats);
+    uint16_t rx_overruns = canrx_getOverruns();
+    memcpy(&rtr_buff[0], &tx_stats.dropped, sizeof(uint16_t));
+    memcpy(&rtr_buff[2], &tx_stats.overruns, sizeof(uint16_t));
+    memcpy(&rtr_buff[4], &rx_overruns, sizeof(uint16_t));
+    rtr_buff[6] = tx_stats.busOff;
+    rtr_buff[7] = reset_cause;
+    canrtr_update(RTR_ERRORS, 8, rtr_buff);
+
+    memcpy(&rtr_buff[0], &control_time_last, sizeof(uint16_t));
+    memcpy(&rtr_buff[2], &control_time_peak, sizeof(uint16_t));
+    memcpy(&rtr_buff[4], &boot_tick_time, sizeof(uint16_t));
+    rtr_buff[6] = tx_stats.maxLevel;
+    sched_stats_t control_stats;
+    sched_getStats(TASK_CONTROL, &control_stats);
+    rtr_buff[7] = control_stats.overruns > 0xFF ? 0xFF : control_stats.overruns;
+    canrtr_update(RTR_LOOP_STATS, 8, rtr_buff);
+}
+
+
+
+/** CAN FRAME HANDLERS (called by canrx_dispatch in the control task) **/
+void onAccelFrame(const canrx_frame_t* Frame) {
+    // SET ACCEL REQUEST
+    if (Frame->dlc != 4) return;
+#if CONTROL_FIXED_POINT
+    // Convert once per frame, the control task only adds the step
+    float accel_cmd_radss;
+    memcpy(&accel_cmd_radss, Frame->data, sizeof(float));
+    accel_step_q16 = q16_clamp(q16_fromFloat(accel_cmd_radss / ACCEL_REFRESH_HZ), SPEED_CMD_MAX_Q16);
+#else
+    memcpy(&accel_cmd_radss, Frame->data, sizeof(float));
+#endif
+}
+
+void onGroupFrame(const canrx_frame_t* Frame) {
+    // GROUP ACCEL REQUEST (one int16 slot per node)
+    if (Frame->id - CAN_ID_GROUP_FIRST != node_index / GROUP_NODES) return;
+    uint8_t slot = node_index % GROUP_NODES;
+    if (Frame->dlc < 2 * (slot + 1)) return;
+    int16_t value;
+    memcpy(&value, &Frame->data[2 * slot], sizeof(int16_t));
+    if (value == GROUP_SLOT_NONE) return;
+#if CONTROL_FIXED_POINT
+    // Q.GROUP_ACCEL_BITS to Q16.16, divided by the control rate (no soft-float)
+    accel_step_q16 = q16_clamp((value * (1L << (Q16_FRAC_BITS - GROUP_ACCEL_BITS))) / ACCEL_REFRESH_HZ, SPEED_CMD_MAX_Q16);
+#else
+    accel_cmd_radss = (float)value / (1 << GROUP_ACCEL_BITS);
+#endif
+}
+
+void onSyncFrame(const canrx_frame_t* Frame) {
+    // SYNC (called by the CAN interrupt) : latch the position and the speed, send the snapshot
+    int32_t position = hall_getPosition32();
+    q16_t speed = speedobs_getSpeed();
+    uint16_t age = Frame->time - control_tick_time.read();
+
+    // Realign the schedule : the control runs one scheduler tick after SYNC on every board
+    if (sync_realign) {
+        sched_realign(Frame->time);
+    }
+
+    int16_t speed_frame = telemetry_speed(speed);
+    memcpy(&snapshot_buff[0], &position, sizeof(int32_t));
+    memcpy(&snapshot_buff[4], &speed_frame, sizeof(int16_t));
+    memcpy(&snapshot_buff[6], &age, sizeof(uint16_t));
+    cantx_send(CAN_ID_SNAPSHOT + node_index, 8, snapshot_buff);
+}
+
+void initRemoteObjects() {
+    // Remote objects of this node : answered by the CAN interrupt, refreshed again by the next control tick
+    uint16_t first_id = CAN_ID_RTR(node_index);
+    canrtr_init(first_id);
+    canrx_setRange(canrtr_onRemoteFrame, first_id, first_id + CAN_ID_RTR_SIZE - 1);
+    initCANMOBasIDBandReceiver(3, first_id, CAN_ID_RTR_SIZE, 1);
+}
+
+void setNodeIndex(int16_t value) {
+    if (value < 0 || value > NODE_INDEX_MAX) return;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        // The CAN interrupt sees the node index and its remote object band change together, the frames sent from
+        // now on use the identifiers of the new node (base identifier + node index)
+        node_index = value;
+        initRemoteObjects();
+    }
+    node_index_pending = true;
+}
+
+void onParamFrame(const canrx_frame_t* Frame) {
+    // SET PARAMETER REQUEST
+    if (Frame->dlc != 3) return;
+    int16_t value;
+    memcpy(&value, &Frame->data[1], sizeof(int16_t));
+    switch (Frame->data[0]) {
+        case PARAM_KP  : speedctrl_setKp(value); break;
+        case PARAM_KI  : speedctrl_setKi(value); break;
+        case PARAM_KAW : speedctrl_setKaw(value); break;
+        case PARAM_DRIVE_MODE : bldc_setDriveMode(value); break;
+        case PARAM_PHASE_ADVANCE : bldc_setPhaseAdvance(value); break;
+        case PARAM_CURRENT_KP : current_setKp(value); break;
+        case PARAM_CURRENT_KI : current_setKi(value); break;
+        case PARAM_TELEMETRY_HZ : telemetry_setRate(value < 0 ? 0 : value); break;
+        case PARAM_LEGACY_SPEED : legacy_speed = (value != 0); break;
+        case PARAM_NODE_INDEX : setNodeIndex(value); break;
+        case PARAM_SYNC_REALIGN : sync_realign = (value != 0); break;
+        case PARAM_TRACE_ARM : trace_arm(value); break;
+        case PARAM_TRACE_POST : trace_setPost(value < 0 ? 0 : value); break;
+        case PARAM_TRACE_TRIGGER : trace_trigger(TRACE_TRIGGER_CAN); break;
+        case PARAM_PWM_FREQUENCY : if (value > 0) bldc_setPwmFrequency(value*10UL, PWM_DEADTIME_NS); break;
+        default : return;
+    }
+    updateParamObject();
+}
+
+
+
+/** TASKS (run by the scheduler in the main context, see the task table) **/
+void controlTask() {
+    /**
+     * Task handling the computation of the voltage needed to be sent to the motor according
+     * to the desired torque command.
+    **/
+    uint16_t control_start = timebase_now();
+    control_tick_time.write(control_start);
+
+    // Process the received commands
+    canrx_dispatch();
+
+    // Boot : the motor is commanded once the PWM is running
+    if (!motor_ready) return;
+    if (!boot_tick) {
+        boot_tick_time = timebase_now();
+        boot_tick = true;
+    }
+    // Control load on the red LED (left to the boot blink until it is done)
+    bool load_led = !red_led.isBlinking();
+    if (load_led) red_led.on();
+
+#if CONTROL_FIXED_POINT
+    // Estimate the motor speed from the hall edges
+    speed_q16 = speedobs_update();
+
+    // Numerically integrate the desired acceleration (the step is pre-divided by ACCEL_REFRESH_HZ)
+    speed_cmd_q16 = q16_clamp(speed_cmd_q16 + accel_step_q16, SPEED_CMD_MAX_Q16);
+
+#if CONTROL_CURRENT_LOOP
+    // Compute the current command (PI on the measured speed), the back-EMF is compensated by the current loop
+    voltage_cmd_pwm = speedctrl_update(0, speed_cmd_q16 - speed_q16);
+    current_setCommand(voltage_cmd_pwm, q16_toInt(q16_mulQ10(speed_q16, SPEED_TO_PWM_Q10)));
+#else
+    // Compute the voltage command (feedforward + PI on the measured speed)
+    voltage_cmd_pwm = speedctrl_update(q16_mulQ10(speed_cmd_q16, SPEED_TO_PWM_Q10), speed_cmd_q16 - speed_q16);
+#endif
+#else
+    // Estimate the motor speed from the hall edges
+    speed_rads = q16_toFloat(speedobs_update());
+
+    // Numerically integrate the desired acceleration
+    speed_cmd_rads = speed_cmd_rads + accel_cmd_radss / ACCEL_REFRESH_HZ;
+    if (speed_cmd_rads > SPEED_CMD_MAX_RADS) speed_cmd_rads = SPEED_CMD_MAX_RADS;
+    if (speed_cmd_rads < -SPEED_CMD_MAX_RADS) speed_cmd_rads = -SPEED_CMD_MAX_RADS;
+
+#if CONTROL_CURRENT_LOOP
+    // Compute the current command (PI on the measured speed), the back-EMF is compensated by the current loop
+    voltage_cmd_pwm = speedctrl_update(0, q16_fromFloat(speed_cmd_rads - speed_rads));
+    current_setCommand(voltage_cmd_pwm, (int16_t)(VOLTS_TO_PWM_RATIO * M_SPEEDCONST * speed_rads));
+#else
+    // Compute the voltage command (feedforward + PI on the measured speed)
+    voltage_cmd_pwm = speedctrl_update(q16_fromFloat(VOLTS_TO_PWM_RATIO * M_SPEEDCONST * speed_cmd_rads),
+                                       q16_fromFloat(speed_cmd_rads - speed_rads));
+#endif
+#endif
+#if !CONTROL_CURRENT_LOOP
+    bldc_setSpeed(voltage_cmd_pwm);
+#endif
+
+    // Remote objects (answered by the CAN interrupt without waiting for the next tick)
+#if CONTROL_FIXED_POINT
+    updateControlObjects(speed_q16, speed_cmd_q16);
+#else
+    updateControlObjects(q16_fromFloat(speed_rads), q16_fromFloat(speed_cmd_rads));
+#endif
+
+    // Trace (triggered by a new hall error or the speed controller saturation)
+    uint8_t trace_events = 0;
+    uint8_t errors = hall_getErrorCount();
+    if (errors != hall_errors) { trace_events |= TRACE_TRIGGER_HALL_ERROR; hall_errors = errors; }
+    if (speedctrl_isSaturated()) trace_events |= TRACE_TRIGGER_SATURATION;
+#if CONTROL_FIXED_POINT
+    trace_control(telemetry_speed(speed_cmd_q16), telemetry_speed(speed_q16), voltage_cmd_pwm,
+                  hall_getLastSensors(), hall_getPosition32(), trace_events);
+#else
+    trace_control(telemetry_speed(q16_fromFloat(speed_cmd_rads)), telemetry_speed(q16_fromFloat(speed_rads)), voltage_cmd_pwm,
+                  hall_getLastSensors(), hall_getPosition32(), trace_events);
+#endif
+
+    uint16_t control_time = timebase_now() - control_start;
+    if (control_time > control_time_max) control_time_max = control_time;
+    if (control_time > control_time_peak) control_time_peak = control_time;
+    control_time_last = control_time;
+
+    if (load_led) red_led.off();
+}
+
+void telemetryTask() {
+    // Telemetry (enqueued, sent by the CAN interrupt), released with the control : same tick data
+    if (!motor_ready || !telemetry_tick()) return;
+
+    uint8_t status = controlStatus();
+    if (status & TELEMETRY_STATUS_HALL_ERROR) hall_resetError();
+    cantx_stats_t tx_stats;
+    cantx_getStats(&tx_stats);
+    uint16_t tx_dropped = tx_stats.dropped + tx_stats.overruns;
+    if (tx_dropped != can_tx_dropped) { status |= TELEMETRY_STATUS_CAN_TX; can_tx_dropped = tx_dropped; }
+    uint16_t rx_overruns = canrx_getOverruns();
+    if (rx_overruns != can_rx_overruns) { status |= TELEMETRY_STATUS_CAN_RX; can_rx_overruns = rx_overruns; }
+#if CONTROL_FIXED_POINT
+    telemetry_pack(telemetry_buff, speed_q16, hall_getPosition32(), voltage_cmd_pwm, status, control_time_max);
+#else
+    telemetry_pack(telemetry_buff, q16_fromFloat(speed_rads), hall_getPosition32(), voltage_cmd_pwm, status, control_time_max);
+#endif
+    cantx_send(CAN_ID_TELEMETRY + node_index, TELEMETRY_DLC, telemetry_buff);
+    control_time_max = 0;
+}
+
+void housekeepingTask() {
+    // Boot and PWM frequency changes : the PSC is started once the PLL is locked
+    bool pwm_ready = bldc_isReady();
+
+    // Boot : enable the motor as soon as the PWM is running
+    if (!motor_ready && pwm_ready) {
+        bldc_enableMotor();
+        motor_ready = true;
+    }
+
+    // Node index changed by the parameter frame : the EEPROM write (several ms) stays out of the control task
+    if (node_index_pending) {
+        node_index_pending = false;
+        eeprom_update_byte(&node_index_eeprom, node_index);
+    }
+
+    // Boot : report the reset cause and the time to the first control tick
+    if (boot_tick && !status_sent) {
+        can_buff[0] = reset_cause;
+        memcpy(&can_buff[1], &boot_tick_time, sizeof(uint16_t));
+        sendData(0, CAN_ID_STATUS + node_index, 3, can_buff);
+        status_sent = true;
+    }
+
+    uint16_t now = timebase_now();
+    red_led.update(now);
+    yellow_led.update(now);
+}
+
+void legacySpeedTask() {
+    if (!legacy_speed) return;
+
+    // Send the motor speed estimated by the control task on CAN BUS
+#if CONTROL_FIXED_POINT
+    float speed_copy = q16_toFloat(speed_q16);
+#else
+    float speed_copy = speed_rads;
+#endif
+    memcpy(&can_buff[0], &(speed_copy), sizeof(float));
+    sendData(0, CAN_ID_SPEED + node_index, 4, can_buff);
+}
+
+void traceDumpTask() {
+    // Frozen trace : the header then the records, without filling the transmit queue
+    for (uint8_t i = 0; i < TRACE_DUMP_FRAMES && cantx_getLevel() <= CANTX_QUEUE_SIZE / 2; i++) {
+        uint8_t frame = trace_dump(trace_buff);
+        if (frame == TRACE_DUMP_NONE) return;
+        cantx_send((frame == TRACE_DUMP_HEADER ? CAN_ID_TRACE_HEADER : CAN_ID_TRACE_RECORD) + node_index, TRACE_DLC, trace_buff);
+    }
+}
+
+#if ENABLE_PROFILING
+void diagnosticsTask() {
+    // Interrupt profiling : the summary, then one frame per handler
+    profile_report(diagnostics_buff);
+    cantx_send(CAN_ID_DIAGNOSTICS + node_index, PROFILE_DLC, diagnostics_buff);
+}
+#endif
+
+// Task table : the control and the telemetry are released on the same tick (phase 0), the telemetry
+// runs after the control (priority). The other tasks are shifted to keep the control tick short
+const sched_task_t tasks[] = {
+    // task                 period [ticks]                          phase   priority
+    { controlTask,          SCHED_HZ_TO_TICKS(ACCEL_REFRESH_HZ),    0,      0 },
+    { telemetryTask,        SCHED_HZ_TO_TICKS(ACCEL_REFRESH_HZ),    0,      1 },
+    { housekeepingTask,     SCHED_HZ_TO_TICKS(HOUSEKEEPING_HZ),     5,      2 },
+    { legacySpeedTask,      SCHED_HZ_TO_TICKS(SPEED_REFRESH_HZ),    25,     3 },
+    { traceDumpTask,        SCHED_HZ_TO_TICKS(TRACE_DUMP_HZ),       3,      4 },
+#if ENABLE_PROFILING
+    { diagnosticsTask,      SCHED_HZ_TO_TICKS(DIAGNOSTICS_HZ),      55,     5 },
+#endif
+};
+static_assert(SCHED_TICK_HZ % ACCEL_REFRESH_HZ == 0, "The control rate must divide the scheduler tick");
+static_assert(RTR_PARAMS < CANRTR_NB_OBJECTS && CANRTR_NB_OBJECTS <= CAN_ID_RTR_SIZE, "The remote objects must fit the table and the node band");
 
 
 
 int main(void) {
     cli();
 
+    // Timer1 initialization (free-running timebase at 250kHz, used to timestamp the hall edges)
+    // Started first : the boot time is measured from here
+    timebase_init();
+
+    // Reset cause (power-on, external, brown-out, watchdog), reported in the status frame
+    reset_cause = MCUSR;
+    MCUSR = 0;
+    motor_ready = false;
+    boot_tick = false;
+    status_sent = false;
+    legacy_speed = true;
+    sync_realign = false;
+    control_tick_time.write(0);
+    control_time_max = 0;
+    control_time_last = 0;
+    control_time_peak = 0;
+    boot_tick_time = 0;
+    can_tx_dropped = 0;
+    can_rx_overruns = 0;
+    hall_errors = 0;
+    trace_init();
+    telemetry_init(ACCEL_REFRESH_HZ, TELEMETRY_HZ);
+    node_index = eeprom_read_byte(&node_index_eeprom);
+    if (node_index > NODE_INDEX_MAX) node_index = 0;
+    node_index_pending = false;
+
     // Global variables initialization
     voltage_cmd_pwm = 0.;
+#if CONTROL_FIXED_POINT
+    accel_step_q16 = 0;
+    speed_cmd_q16 = 0;
+    speed_q16 = 0;
+#else
     accel_cmd_radss = 0.;
     speed_cmd_rads = 0.;
     speed_rads = 0.;
-    position = 0;
+#endif
+
+    // Speed controller initialization
+    speedctrl_init(Q_FROM_CONST(PI_KP,10), Q_FROM_CONST(PI_KI/ACCEL_REFRESH_HZ,10), Q_FROM_CONST(PI_KAW,10));
     
     // Enable the LM2575 (step-down switching voltage regulator)
     Output LM2575_enable(&PORTC, PC7);
     LM2575_enable.setLow();
 
-    // Timer1 initialization
-    TCCR1A = 0x00;				                // Set CTC mode 
-    TCCR1B = (1<<WGM12)|(1<<CS11)|(1<<CS10);	// Set CTC mode and Prescaler set to 64 : 250kHz
-    TIMSK1 = (1<<OCIE1A); 			            // Enable compare interrupt on A
-    OCR1A  = 2500;     				            // 250kHz/2500 = 100Hz
-
     // CAN Bus initialization (500Kb/s)
     initCANBus();
-    initCANMOBasReceiver(1, CAN_ID_ACCEL, 0);
+    // Received frames are dispatched by the control task
+    canrx_init();
+    canrx_register(CAN_ID_ACCEL, CAN_ID_ACCEL, onAccelFrame);
+    canrx_register(CAN_ID_PARAM, CAN_ID_PARAM, onParamFrame);
+    canrx_register(CAN_ID_GROUP_FIRST, CAN_ID_GROUP_LAST, onGroupFrame);
+    canrx_register(CAN_ID_SYNC, CAN_ID_SYNC, onSyncFrame, true);
+    // Remote frames are answered by the CAN interrupt from the objects refreshed by the control task
+    canrx_register(CAN_ID_RTR(node_index), CAN_ID_RTR(node_index) + CAN_ID_RTR_SIZE - 1, canrtr_onRemoteFrame, true);
+    initCANMOBasIDBandReceiver(1, CAN_ID_CMD_FIRST, CAN_ID_CMD_SIZE, 0);
+    initCANMOBasReceiver(2, CAN_ID_SYNC, 0);
+    initRemoteObjects();
 
-    // BLDC Motor initialization
-    bldc_init();
-    bldc_enableMotor();
+    // BLDC Motor initialization (the PLL is started, the motor is enabled by the housekeeping task once it is locked)
+    bldc_begin();
+    speedobs_init(SPEED_EDGE_GAIN_Q16);
+    updateParamObject();
+#if CONTROL_CURRENT_LOOP
+    // Shunt current sampling and inner current loop (the conversions are triggered once the PSC runs)
+    current_init(Q_FROM_CONST(CURRENT_KP,10), Q_FROM_CONST(CURRENT_KI,10), CURRENT_LIMIT);
+    // The speed controller saturates and winds back on the current command bound
+    speedctrl_setOutputMax(CURRENT_LIMIT);
+    current_enableLoop(true);
+#endif
+
+    // Scheduler (Timer1 compare A tick, the control and the other tasks run in the main context)
+#if ENABLE_PROFILING
+    profile_init();
+#endif
+    sched_init(tasks, sizeof(tasks) / sizeof(tasks[0]));
+    sched_start();
 	
-    // Blink the leds
-    for(int i=0; i<4; i++){
-        red_led.blink(50);
-        yellow_led.blink(50);
-    }    
+    // Blink the leds (done by the housekeeping task)
+    red_led.startBlink(BOOT_BLINKS, TIMEBASE_US_TO_TICKS(BOOT_BLINK_MS*1000UL), timebase_now());
+    yellow_led.startBlink(BOOT_BLINKS, TIMEBASE_US_TO_TICKS(BOOT_BLINK_MS*1000UL), timebase_now());
 
     sei();
-    
-    while(1) {
-        // Compute the motor speed
-        speed_rads = (float)((hall_getPosition() - position)*PI2*SPEED_REFRESH_HZ/TICKS_TO_ROUNDS);  
 
-        // Send data on CAN BUS
-        memcpy(&can_buff[0], &(speed_rads), sizeof(float));
-        sendData(0, CAN_ID_SPEED, 4, can_buff);
-	
-        position = hall_getPosition();
-        _delay_ms(50);      // 20Hz
+    while(1) {
+        // Run the released tasks, sleep until the next interrupt
+        sched_run();
     }
 }
 
 
-ISR(TIMER1_COMPA_vect) {
-    /**
-     * Interrupt handling the computation of the voltage needed to be sent to the motor according 
-     * to the desired torque command.
-    **/
-    cli();
-	red_led.on();  
-
-    // Numerically integrate the desired acceleration
-    speed_cmd_rads = speed_cmd_rads + accel_cmd_radss / ACCEL_REFRESH_HZ;
-
-    // Compute the voltage command
-    voltage_cmd_pwm = (int16_t) (VOLTS_TO_PWM_RATIO * M_SPEEDCONST * speed_cmd_rads);
-    bldc_setSpeed(voltage_cmd_pwm);
-
-    red_led.off();
-    sei();
-}
-
-
 ISR(CAN_INT_vect) {
-    cli();
+    PROFILE_ISR(PROFILE_CAN);
 
-    if ((CANSIT2 & 0x02) != 0x00) {			// SET ACCEL REQUEST
-        yellow_led.on();
-        CANPAGE = 0x10; uint8_t dlc = CANCDMOB & 0x0F;	// Select MOb1 - Get the DLC of the CAN frame
-	    if(dlc == 0x04) {
-            CANPAGE = 0x10; accel_buff[0] = CANMSG;
-            CANPAGE = 0x11; accel_buff[1] = CANMSG;
-            CANPAGE = 0x12; accel_buff[2] = CANMSG;
-            CANPAGE = 0x13; accel_buff[3] = CANMSG;
-	        memcpy(&accel_cmd_radss, accel_buff, sizeof(float));
-	    }
-        // Reset the MOB configuration for next CAN message
-        CANPAGE   = 0x10; // select MOB1
-        CANSTMOB  = 0x00; // Reset the status of the MOB1
-        CANCDMOB  = 0x80; // Config as reception MOB1
-        CANIE2   |= 0x02; // Enable the interruption over MOB 1 (for the next one)
-        CANSIT2  &= 0xFD; // remove the MOB1 raised flag
-        yellow_led.off();
-    }
+    // Transmitted frames and bus-off (loads the next queued frames)
+    cantx_onInterrupt();
 
-    sei();
+    // Received frames (copied to the receive ring), CAN activity on the yellow LED (left to the boot blink until it is done)
+    bool activity_led = !yellow_led.isBlinking();
+    if (activity_led) yellow_led.on();
+    canrx_onInterrupt();
+    if (activity_led) yellow_led.off();
 }
@@ -0,0 +1,17 @@
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+#include <stdint.h>
+
+
+// Host replacement of <avr/eeprom.h> : the EEPROM variables are in RAM (erased at each start)
+
+
+#define EEMEM
+
+static inline uint8_t eeprom_read_byte(const uint8_t* Address) { return *Address; }
+static inline void eeprom_update_byte(uint8_t* Address, uint8_t Value) { *Address = Value; }
+static inline void eeprom_write_byte(uint8_t* Address, uint8_t Value) { *Address = Value; }
+
+
+#endif // HOST_AVR_EEPROM_H
@@ -0,0 +1,30 @@
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+
+// Host replacement of <avr/interrupt.h> (see host/hal.h)
+// An ISR is a C function named after its vector number, called by the dispatch of host/hal.cpp with the global
+// interrupt flag cleared (the interrupts never nest, ISR_NOBLOCK is not provided)
+
+
+#define HOST_STRINGIFY_(x)      #x
+#define HOST_STRINGIFY(x)       HOST_STRINGIFY_(x)
+
+
+/*!
+ * \brief host_sei      Set the global interrupt flag and serve the pending interrupts
+ */
+void                host_sei();
+
+
+#define sei()                   host_sei()
+#define cli()                   (SREG &= (uint8_t)~(1<<SREG_I))
+
+#define ISR(vector, ...)        extern "C" void vector(void) __VA_ARGS__; extern "C" void vector(void)
+#define ISR_ALIASOF(v)          __attribute__((alias(HOST_STRINGIFY(v))))
+#define EMPTY_INTERRUPT(vector) extern "C" void vector(void) {}
+
+
+#endif // HOST_AVR_INTERRUPT_H
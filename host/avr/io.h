@@ -0,0 +1,457 @@
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+
+// Host replacement of <avr/io.h> for the ATmega32M1 (see host/hal.h)
+// The I/O registers are the bytes of a simulated register file, at their data space address : a register reads the
+// last value written and the peripherals do not run, except the ones modelled by host/hal.cpp (Timer1 compare
+// interrupts, CAN message objects, I/O ports). Apart from CANGIT, the flags cleared by writing one are plain memory.
+
+
+
+
+// ___________________________
+// ::: Simulated registers :::
+
+
+// The registers with a side effect on write (I/O ports, CANGIT) are in a write protected page, each write is trapped
+// and applied by host/hal.cpp (e.g. a one written to PINx toggles PORTx), the others are plain memory
+#define HOST_PAGE_SIZE      0x1000
+
+extern volatile uint8_t     host_sfr[0x100];
+extern volatile uint8_t     host_sfrTrapped[HOST_PAGE_SIZE];
+
+/*!
+ * \brief host_isTrapped    Register in the write protected page (PINB to PORTD, CANGIT)
+ */
+static inline constexpr bool host_isTrapped(uint8_t Address)
+{
+    return (Address>=0x23 && Address<=0x2B) || Address==0xDA;
+}
+
+#define _SFR_MEM8(a)        (*(volatile uint8_t *)&(host_isTrapped(a) ? host_sfrTrapped : host_sfr)[(a)])
+#define _SFR_MEM16(a)       (*(volatile uint16_t *)&host_sfr[(a)])
+#define _BV(b)              (1 << (b))
+
+
+// CAN message object registers (CANSTMOB to CANMSG), one page per MOb selected by CANPAGE
+#define HOST_NB_MOBS        6
+#define HOST_MOB_FIRST      0xEE
+
+typedef struct
+{
+    uint8_t     reg[12];        // CANSTMOB to CANSTM (addresses 0xEE to 0xF9)
+    uint8_t     msg[8];         // Data buffer (CANMSG)
+} __attribute__((aligned(2))) host_mob_t;
+
+extern volatile host_mob_t  host_Mobs[HOST_NB_MOBS+1];      // The last page is selected by the MOb numbers 6 to 15
+
+
+/*!
+ * \brief host_mobRegister  Register of the MOb selected by CANPAGE
+ */
+static inline volatile uint8_t* host_mobRegister(uint8_t Address)
+{
+    uint8_t Mob=host_sfr[0xED]>>4;
+    return &host_Mobs[Mob<HOST_NB_MOBS ? Mob : HOST_NB_MOBS].reg[Address-HOST_MOB_FIRST];
+}
+
+
+/*!
+ * \brief host_canMessage   CANMSG : data byte of the MOb selected by CANPAGE, at the data index of CANPAGE
+ *                          The index is incremented after the access unless AINC is set
+ */
+uint8_t             host_canMessage(bool Write, uint8_t Value);
+
+
+/*!
+ * \brief host_canStatus    CANSIT2 : the MObs with an interrupt flag set and enabled in CANIE2 (read only)
+ */
+uint8_t             host_canStatus();
+
+
+/*!
+ * \brief The host_canmsg class     CANMSG, each access moves the data index
+ */
+class host_canmsg
+{
+public:
+    operator uint8_t() const { return host_canMessage(false, 0); }
+    host_canmsg& operator=(uint8_t Value) { host_canMessage(true, Value); return *this; }
+};
+
+#define _SFR_MOB8(a)        (*host_mobRegister(a))
+#define _SFR_MOB16(a)       (*(volatile uint16_t *)host_mobRegister(a))
+
+
+
+
+// _________________
+// ::: Registers :::
+
+
+#define SREG                _SFR_MEM8(0x5F)
+#define PINB                _SFR_MEM8(0x23)
+#define DDRB                _SFR_MEM8(0x24)
+#define PORTB               _SFR_MEM8(0x25)
+#define PINC                _SFR_MEM8(0x26)
+#define DDRC                _SFR_MEM8(0x27)
+#define PORTC               _SFR_MEM8(0x28)
+#define PIND                _SFR_MEM8(0x29)
+#define DDRD                _SFR_MEM8(0x2A)
+#define PORTD               _SFR_MEM8(0x2B)
+#define TIFR0               _SFR_MEM8(0x35)
+#define TIFR1               _SFR_MEM8(0x36)
+#define PCIFR               _SFR_MEM8(0x3B)
+#define EECR                _SFR_MEM8(0x3F)
+#define TCCR0A              _SFR_MEM8(0x44)
+#define TCCR0B              _SFR_MEM8(0x45)
+#define TCNT0               _SFR_MEM8(0x46)
+#define OCR0A               _SFR_MEM8(0x47)
+#define OCR0B               _SFR_MEM8(0x48)
+#define PLLCSR              _SFR_MEM8(0x49)
+#define ACSR                _SFR_MEM8(0x50)
+#define SMCR                _SFR_MEM8(0x53)
+#define MCUSR               _SFR_MEM8(0x54)
+#define PCICR               _SFR_MEM8(0x68)
+#define PCMSK0              _SFR_MEM8(0x6A)
+#define PCMSK1              _SFR_MEM8(0x6B)
+#define PCMSK2              _SFR_MEM8(0x6C)
+#define PCMSK3              _SFR_MEM8(0x6D)
+#define TIMSK0              _SFR_MEM8(0x6E)
+#define TIMSK1              _SFR_MEM8(0x6F)
+#define AMP0CSR             _SFR_MEM8(0x75)
+#define AMP1CSR             _SFR_MEM8(0x76)
+#define AMP2CSR             _SFR_MEM8(0x77)
+#define ADC                 _SFR_MEM16(0x78)
+#define ADCW                ADC
+#define ADCSRA              _SFR_MEM8(0x7A)
+#define ADCSRB              _SFR_MEM8(0x7B)
+#define ADMUX               _SFR_MEM8(0x7C)
+#define DIDR0               _SFR_MEM8(0x7E)
+#define DIDR1               _SFR_MEM8(0x7F)
+#define TCCR1A              _SFR_MEM8(0x80)
+#define TCCR1B              _SFR_MEM8(0x81)
+#define TCCR1C              _SFR_MEM8(0x82)
+#define TCNT1               _SFR_MEM16(0x84)
+#define ICR1                _SFR_MEM16(0x86)
+#define OCR1A               _SFR_MEM16(0x88)
+#define OCR1B               _SFR_MEM16(0x8A)
+#define AC0CON              _SFR_MEM8(0x94)
+#define AC1CON              _SFR_MEM8(0x95)
+#define AC2CON              _SFR_MEM8(0x96)
+#define AC3CON              _SFR_MEM8(0x97)
+#define POCR0SA             _SFR_MEM16(0xA0)
+#define POCR0RA             _SFR_MEM16(0xA2)
+#define POCR0SB             _SFR_MEM16(0xA4)
+#define POCR1SA             _SFR_MEM16(0xA6)
+#define POCR1RA             _SFR_MEM16(0xA8)
+#define POCR1SB             _SFR_MEM16(0xAA)
+#define POCR2SA             _SFR_MEM16(0xAC)
+#define POCR2RA             _SFR_MEM16(0xAE)
+#define POCR2SB             _SFR_MEM16(0xB0)
+#define POCR_RB             _SFR_MEM16(0xB2)
+#define PSYNC               _SFR_MEM8(0xB4)
+#define PCNF                _SFR_MEM8(0xB5)
+#define POC                 _SFR_MEM8(0xB6)
+#define PCTL                _SFR_MEM8(0xB7)
+#define PMIC0               _SFR_MEM8(0xB8)
+#define PMIC1               _SFR_MEM8(0xB9)
+#define PMIC2               _SFR_MEM8(0xBA)
+#define PIM                 _SFR_MEM8(0xBB)
+#define PIFR                _SFR_MEM8(0xBC)
+#define CANGCON             _SFR_MEM8(0xD8)
+#define CANGSTA             _SFR_MEM8(0xD9)
+#define CANGIT              _SFR_MEM8(0xDA)
+#define CANGIE              _SFR_MEM8(0xDB)
+#define CANEN2              _SFR_MEM8(0xDC)
+#define CANEN1              _SFR_MEM8(0xDD)
+#define CANIE2              _SFR_MEM8(0xDE)
+#define CANIE1              _SFR_MEM8(0xDF)
+#define CANSIT1             _SFR_MEM8(0xE1)
+#define CANBT1              _SFR_MEM8(0xE2)
+#define CANBT2              _SFR_MEM8(0xE3)
+#define CANBT3              _SFR_MEM8(0xE4)
+#define CANTCON             _SFR_MEM8(0xE5)
+#define CANTIM              _SFR_MEM16(0xE6)
+#define CANTTC              _SFR_MEM16(0xE8)
+#define CANTEC              _SFR_MEM8(0xEA)
+#define CANREC              _SFR_MEM8(0xEB)
+#define CANHPMOB            _SFR_MEM8(0xEC)
+#define CANPAGE             _SFR_MEM8(0xED)
+#define CANSIT2             (host_canStatus())
+#define CANSTMOB            _SFR_MOB8(0xEE)
+#define CANCDMOB            _SFR_MOB8(0xEF)
+#define CANIDT4             _SFR_MOB8(0xF0)
+#define CANIDT3             _SFR_MOB8(0xF1)
+#define CANIDT2             _SFR_MOB8(0xF2)
+#define CANIDT1             _SFR_MOB8(0xF3)
+#define CANIDM4             _SFR_MOB8(0xF4)
+#define CANIDM3             _SFR_MOB8(0xF5)
+#define CANIDM2             _SFR_MOB8(0xF6)
+#define CANIDM1             _SFR_MOB8(0xF7)
+#define CANSTM              _SFR_MOB16(0xF8)
+#define CANMSG              (host_canmsg())
+
+
+
+
+// ____________
+// ::: Bits :::
+
+
+#define PB0                 0
+#define PB1                 1
+#define PB2                 2
+#define PB3                 3
+#define PB4                 4
+#define PB5                 5
+#define PB6                 6
+#define PB7                 7
+#define PC0                 0
+#define PC1                 1
+#define PC2                 2
+#define PC3                 3
+#define PC4                 4
+#define PC5                 5
+#define PC6                 6
+#define PC7                 7
+#define PD0                 0
+#define PD1                 1
+#define PD2                 2
+#define PD3                 3
+#define PD4                 4
+#define PD5                 5
+#define PD6                 6
+#define PD7                 7
+#define PCIE0               0
+#define PCIE1               1
+#define PCIE2               2
+#define PCIE3               3
+#define PCINT14             6
+#define PCINT21             5
+#define PCINT23             7
+#define WGM00               0
+#define WGM01               1
+#define CS00                0
+#define CS01                1
+#define CS02                2
+#define WGM02               3
+#define TOIE0               0
+#define OCIE0A              1
+#define OCIE0B              2
+#define OCF0A               1
+#define CS10                0
+#define CS11                1
+#define CS12                2
+#define WGM12               3
+#define WGM13               4
+#define TOIE1               0
+#define OCIE1A              1
+#define OCIE1B              2
+#define ICIE1               5
+#define TOV1                0
+#define OCF1A               1
+#define OCF1B               2
+#define PLOCK               0
+#define PLLE                1
+#define PLLF                2
+#define SE                  0
+#define SM0                 1
+#define SM1                 2
+#define SM2                 3
+#define PRUN                0
+#define PCCYC               1
+#define PCLKSEL             5
+#define PPRE0               6
+#define PPRE1               7
+#define POPA                2
+#define POPB                3
+#define PMODE               4
+#define PULOCK              5
+#define PALOCK              6
+#define PFIFTY              7
+#define POVEN0              7
+#define POVEN1              7
+#define POVEN2              7
+#define PEOPE               0
+#define PEOP                0
+#define ADPS0               0
+#define ADPS1               1
+#define ADPS2               2
+#define ADIE                3
+#define ADIF                4
+#define ADATE               5
+#define ADSC                6
+#define ADEN                7
+#define ADTS0               0
+#define ADTS1               1
+#define ADTS2               2
+#define ADTS3               3
+#define AREFEN              5
+#define ISRCEN              6
+#define ADHSM               7
+#define MUX0                0
+#define ADLAR               5
+#define REFS0               6
+#define REFS1               7
+#define AMP0EN              7
+#define AMP0IS              6
+#define AMP0G1              5
+#define AMP0G0              4
+#define AMPCMP0             3
+#define AMP0TS2             2
+#define AMP0TS1             1
+#define AMP0TS0             0
+#define AC0EN               7
+#define AC0IE               6
+#define AC0IS1              5
+#define AC0IS0              4
+#define AC0M0               0
+#define AC1EN               7
+#define AC1IE               6
+#define AC1IS1              5
+#define AC1IS0              4
+#define AC2EN               7
+#define AC2IE               6
+#define AC2IS1              5
+#define AC2IS0              4
+#define AC0O                0
+#define AC1O                1
+#define AC2O                2
+#define AC0IF               4
+#define AC1IF               5
+#define AC2IF               6
+#define SWRES               0
+#define ENASTB              1
+#define TEST                2
+#define LISTEN              3
+#define ABRQ                7
+#define ERRP                0
+#define BOFF                1
+#define ENFG                2
+#define AERG                0
+#define FERG                1
+#define CERG                2
+#define SERG                3
+#define BXOK                4
+#define OVRTIM              5
+#define BOFFIT              6
+#define CANIT               7
+#define ENOVRT              0
+#define ENERG               1
+#define ENBX                2
+#define ENERR               3
+#define ENTX                4
+#define ENRX                5
+#define ENBOFF              6
+#define ENIT                7
+#define AERR                0
+#define FERR                1
+#define CERR                2
+#define SERR                3
+#define BERR                4
+#define RXOK                5
+#define TXOK                6
+#define DLCW                7
+#define IDE                 4
+#define RPLV                5
+#define CONMOB0             6
+#define CONMOB1             7
+#define RTRTAG              2
+#define RTRMSK              2
+#define IDEMSK              0
+#define AINC                3
+#define TXBSY               4
+#define RXBSY               3
+#define PCIF0               0
+#define AMP1EN              7
+#define AMP1IS              6
+#define AMP1G1              5
+#define AMP1G0              4
+#define AMPCMP1             3
+#define AMP1TS2             2
+#define AMP1TS1             1
+#define AMP1TS0             0
+#define PORF                0
+#define EXTRF               1
+#define BORF                2
+#define WDRF                3
+#define SREG_I              7
+
+
+
+
+// _______________
+// ::: Vectors :::
+
+
+// ATmega32M1 vector numbers (0 is the reset), the lowest number is served first
+#define _VECTOR(N)              __vector_ ## N
+#define _VECTORS_SIZE           31
+
+#define ANACOMP0_vect_num       1
+#define ANACOMP0_vect           _VECTOR(1)
+#define ANACOMP1_vect_num       2
+#define ANACOMP1_vect           _VECTOR(2)
+#define ANACOMP2_vect_num       3
+#define ANACOMP2_vect           _VECTOR(3)
+#define ANACOMP3_vect_num       4
+#define ANACOMP3_vect           _VECTOR(4)
+#define PSC_FAULT_vect_num      5
+#define PSC_FAULT_vect          _VECTOR(5)
+#define PSC_EC_vect_num         6
+#define PSC_EC_vect             _VECTOR(6)
+#define INT0_vect_num           7
+#define INT0_vect               _VECTOR(7)
+#define INT1_vect_num           8
+#define INT1_vect               _VECTOR(8)
+#define INT2_vect_num           9
+#define INT2_vect               _VECTOR(9)
+#define INT3_vect_num           10
+#define INT3_vect               _VECTOR(10)
+#define TIMER1_CAPT_vect_num    11
+#define TIMER1_CAPT_vect        _VECTOR(11)
+#define TIMER1_COMPA_vect_num   12
+#define TIMER1_COMPA_vect       _VECTOR(12)
+#define TIMER1_COMPB_vect_num   13
+#define TIMER1_COMPB_vect       _VECTOR(13)
+#define TIMER1_OVF_vect_num     14
+#define TIMER1_OVF_vect         _VECTOR(14)
+#define TIMER0_COMPA_vect_num   15
+#define TIMER0_COMPA_vect       _VECTOR(15)
+#define TIMER0_COMPB_vect_num   16
+#define TIMER0_COMPB_vect       _VECTOR(16)
+#define TIMER0_OVF_vect_num     17
+#define TIMER0_OVF_vect         _VECTOR(17)
+#define CAN_INT_vect_num        18
+#define CAN_INT_vect            _VECTOR(18)
+#define CAN_TOVF_vect_num       19
+#define CAN_TOVF_vect           _VECTOR(19)
+#define LIN_TC_vect_num         20
+#define LIN_TC_vect             _VECTOR(20)
+#define LIN_ERR_vect_num        21
+#define LIN_ERR_vect            _VECTOR(21)
+#define PCINT0_vect_num         22
+#define PCINT0_vect             _VECTOR(22)
+#define PCINT1_vect_num         23
+#define PCINT1_vect             _VECTOR(23)
+#define PCINT2_vect_num         24
+#define PCINT2_vect             _VECTOR(24)
+#define PCINT3_vect_num         25
+#define PCINT3_vect             _VECTOR(25)
+#define SPI_STC_vect_num        26
+#define SPI_STC_vect            _VECTOR(26)
+#define ADC_vect_num            27
+#define ADC_vect                _VECTOR(27)
+#define WDT_vect_num            28
+#define WDT_vect                _VECTOR(28)
+#define EE_READY_vect_num       29
+#define EE_READY_vect           _VECTOR(29)
+#define SPM_READY_vect_num      30
+#define SPM_READY_vect          _VECTOR(30)
+
+
+#endif // HOST_AVR_IO_H
@@ -0,0 +1,15 @@
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+
+
+// Host replacement of <avr/pgmspace.h> : the program memory constants are ordinary constants
+
+
+#define PROGMEM
+#define pgm_read_byte(address)  (*(const uint8_t *)(address))
+#define pgm_read_word(address)  (*(const uint16_t *)(address))
+
+
+#endif // HOST_AVR_PGMSPACE_H
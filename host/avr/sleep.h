@@ -0,0 +1,29 @@
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+#include <avr/io.h>
+
+
+// Host replacement of <avr/sleep.h> : sleeping advances the simulated time to the next interrupt (see host/hal.h)
+
+
+/*!
+ * \brief host_sleepEnable  Set SE, an interrupt served before host_sleep wakes the CPU at once (sei then sleep)
+ */
+void                host_sleepEnable();
+
+
+/*!
+ * \brief host_sleep        Sleep until an interrupt is served (no effect if SE is cleared)
+ */
+void                host_sleep();
+
+
+#define SLEEP_MODE_IDLE         0
+#define set_sleep_mode(mode)    (SMCR = (SMCR & ~((1<<SM0)|(1<<SM1)|(1<<SM2))) | (mode))
+#define sleep_enable()          host_sleepEnable()
+#define sleep_disable()         (SMCR &= (uint8_t)~(1<<SE))
+#define sleep_cpu()             host_sleep()
+
+
+#endif // HOST_AVR_SLEEP_H
@@ -0,0 +1,531 @@
+#include "hal.h"
+#include <avr/sleep.h>
+#include <util/atomic.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#if !defined(__linux__) || !defined(__x86_64__)
+#error "The host build traps the register writes with the x86-64 trap flag (Linux)"
+#endif
+
+
+
+
+// _________________________
+// ::: Interrupt vectors :::
+
+
+// Vectors without a service routine in the firmware are null (weak symbols), serving one aborts
+#define HOST_WEAK_VECTOR(N)     extern "C" void _VECTOR(N)(void) __attribute__((weak));
+
+HOST_WEAK_VECTOR(1)  HOST_WEAK_VECTOR(2)  HOST_WEAK_VECTOR(3)  HOST_WEAK_VECTOR(4)  HOST_WEAK_VECTOR(5)
+HOST_WEAK_VECTOR(6)  HOST_WEAK_VECTOR(7)  HOST_WEAK_VECTOR(8)  HOST_WEAK_VECTOR(9)  HOST_WEAK_VECTOR(10)
+HOST_WEAK_VECTOR(11) HOST_WEAK_VECTOR(12) HOST_WEAK_VECTOR(13) HOST_WEAK_VECTOR(14) HOST_WEAK_VECTOR(15)
+HOST_WEAK_VECTOR(16) HOST_WEAK_VECTOR(17) HOST_WEAK_VECTOR(18) HOST_WEAK_VECTOR(19) HOST_WEAK_VECTOR(20)
+HOST_WEAK_VECTOR(21) HOST_WEAK_VECTOR(22) HOST_WEAK_VECTOR(23) HOST_WEAK_VECTOR(24) HOST_WEAK_VECTOR(25)
+HOST_WEAK_VECTOR(26) HOST_WEAK_VECTOR(27) HOST_WEAK_VECTOR(28) HOST_WEAK_VECTOR(29) HOST_WEAK_VECTOR(30)
+
+static void (* const host_Vectors[_VECTORS_SIZE])(void) =
+{
+    0,              _VECTOR(1),     _VECTOR(2),     _VECTOR(3),     _VECTOR(4),     _VECTOR(5),
+    _VECTOR(6),     _VECTOR(7),     _VECTOR(8),     _VECTOR(9),     _VECTOR(10),    _VECTOR(11),
+    _VECTOR(12),    _VECTOR(13),    _VECTOR(14),    _VECTOR(15),    _VECTOR(16),    _VECTOR(17),
+    _VECTOR(18),    _VECTOR(19),    _VECTOR(20),    _VECTOR(21),    _VECTOR(22),    _VECTOR(23),
+    _VECTOR(24),    _VECTOR(25),    _VECTOR(26),    _VECTOR(27),    _VECTOR(28),    _VECTOR(29),
+    _VECTOR(30)
+};
+
+
+
+
+// ________________________
+// ::: Global variables :::
+
+
+// Register file, write protected page (registers with a side effect on write) and CAN message objects
+volatile uint8_t    host_sfr[0x100] __attribute__((aligned(2)));
+volatile uint8_t    host_sfrTrapped[HOST_PAGE_SIZE] __attribute__((aligned(HOST_PAGE_SIZE)));
+volatile host_mob_t host_Mobs[HOST_NB_MOBS+1];
+
+// Levels applied on the I/O port pins (B, C, D) by the outside, read through PINx where the pin is an input
+uint8_t             host_PinInputs[3];
+
+// Trapped write being single stepped (address, register value before the write), instruction stepping
+int16_t             host_TrapAddress=-1;
+uint8_t             host_TrapOld;
+host_step_t         host_OnStep;
+uint32_t            host_Steps;
+
+// Pending interrupts (bit n : vector n), interrupts served since the reset
+uint32_t            host_Pending;
+uint32_t            host_Served;
+uint32_t            host_ServedAtSleepEnable;
+
+// Simulated time [CPU cycles], cycles since the last Timer1 tick, time limit of host_sleep (0 : none)
+uint64_t            host_Time;
+uint16_t            host_Phase;
+uint64_t            host_TimeLimit;
+
+// Frames transmitted by host_sleep
+static void host_printFrame(const host_can_frame_t* Frame);
+host_can_log_t      host_CanLog=host_printFrame;
+
+
+
+
+// Offsets of the MOb registers
+#define HOST_CANSTMOB   (0xEE - HOST_MOB_FIRST)
+#define HOST_CANCDMOB   (0xEF - HOST_MOB_FIRST)
+#define HOST_CANIDT4    (0xF0 - HOST_MOB_FIRST)
+#define HOST_CANIDT2    (0xF2 - HOST_MOB_FIRST)
+#define HOST_CANIDT1    (0xF3 - HOST_MOB_FIRST)
+#define HOST_CANIDM4    (0xF4 - HOST_MOB_FIRST)
+#define HOST_CANIDM2    (0xF6 - HOST_MOB_FIRST)
+#define HOST_CANIDM1    (0xF7 - HOST_MOB_FIRST)
+
+// MOb configuration (CONMOB bits of CANCDMOB)
+#define HOST_CONMOB_TX  1
+#define HOST_CONMOB_RX  2
+
+// I/O ports : PINx, DDRx, PORTx from PINB
+#define HOST_PORT_FIRST 0x23
+#define HOST_NB_PORTS   3
+
+// Trap flag of RFLAGS (single step)
+#define HOST_TRAP_FLAG  0x100
+
+// Set and clear the trap flag (separate functions : the red zone of the caller is not touched)
+extern "C" void host_setTrapFlag();
+extern "C" void host_clearTrapFlag();
+__asm__(".text\n"
+        "host_setTrapFlag:\n"
+        "    pushfq\n"
+        "    orq $0x100, (%rsp)\n"
+        "    popfq\n"
+        "    ret\n"
+        "host_clearTrapFlag:\n"
+        "    pushfq\n"
+        "    andq $~0x100, (%rsp)\n"
+        "    popfq\n"
+        "    ret\n");
+
+
+
+
+// Serve the pending interrupts while they are enabled, lowest vector first (the routine runs with the flag cleared)
+static void host_dispatch()
+{
+    while ((SREG & (1<<SREG_I)) && host_Pending!=0)
+    {
+        uint8_t Vector=__builtin_ctz(host_Pending);
+        host_Pending &= ~(1UL<<Vector);
+        if (!host_Vectors[Vector])
+        {
+            fprintf(stderr, "host: interrupt %u without service routine\n", Vector);
+            abort();
+        }
+        SREG &= (uint8_t)~(1<<SREG_I);
+        host_Vectors[Vector]();
+        SREG |= (1<<SREG_I);                    // reti
+        host_Served++;
+    }
+}
+
+
+// Timer1 prescaler (CS12:0), 0 if stopped or clocked externally
+static uint16_t host_prescaler()
+{
+    switch (TCCR1B & ((1<<CS12)|(1<<CS11)|(1<<CS10)))
+    {
+    case 1 : return 1;
+    case 2 : return 8;
+    case 3 : return 64;
+    case 4 : return 256;
+    case 5 : return 1024;
+    default : return 0;
+    }
+}
+
+
+// Timer1 ticks to the next enabled compare match (1 to 65536), 0 if none is enabled
+static uint32_t host_nextMatch()
+{
+    uint32_t Next=0;
+    uint16_t Count=TCNT1;
+    if (TIMSK1 & (1<<OCIE1A))
+    {
+        uint32_t Ticks=(uint16_t)(OCR1A-Count);
+        Next=(Ticks==0) ? 0x10000 : Ticks;
+    }
+    if (TIMSK1 & (1<<OCIE1B))
+    {
+        uint32_t Ticks=(uint16_t)(OCR1B-Count);
+        if (Ticks==0) Ticks=0x10000;
+        if (Next==0 || Ticks<Next) Next=Ticks;
+    }
+    return Next;
+}
+
+
+// Write protection of the trapped registers
+static void host_protect(bool Protected)
+{
+    if (mprotect((void*)host_sfrTrapped, HOST_PAGE_SIZE, Protected ? PROT_READ : PROT_READ|PROT_WRITE)!=0)
+    {
+        perror("host: mprotect");
+        abort();
+    }
+}
+
+
+// Pin levels of a port : the outputs read PORTx, the inputs the level applied by the outside (no pull-up)
+static void host_updatePins(uint8_t Port)
+{
+    volatile uint8_t* Registers=&host_sfrTrapped[HOST_PORT_FIRST+3*Port];
+    Registers[0]=(Registers[2] & Registers[1]) | (host_PinInputs[Port] & ~Registers[1]);
+}
+
+
+// Side effect of a trapped write (page writable), the value written is in place
+static void host_applyWrite(uint8_t Address, uint8_t Old)
+{
+    volatile uint8_t* Register=&host_sfrTrapped[Address];
+    if (Address>=HOST_PORT_FIRST && Address<HOST_PORT_FIRST+3*HOST_NB_PORTS)
+    {
+        uint8_t Port=(Address-HOST_PORT_FIRST)/3;
+        if ((Address-HOST_PORT_FIRST)%3==0) host_sfrTrapped[Address+2] ^= *Register;   // PINx : the ones toggle PORTx
+        host_updatePins(Port);
+    }
+    else if (Address==0xDA)
+    {
+        *Register=Old & ~(*Register) & 0x7F;                                            // CANGIT : write one to clear
+    }
+}
+
+
+// Write to the protected page : the page is made writable and the store is single stepped
+static void host_onWriteFault(int, siginfo_t* Info, void* Context)
+{
+    volatile uint8_t* Address=(volatile uint8_t*)Info->si_addr;
+    if (Address<host_sfrTrapped || Address>=host_sfrTrapped+HOST_PAGE_SIZE || host_TrapAddress>=0)
+    {
+        signal(SIGSEGV, SIG_DFL);               // Not a register write : the fault is raised again, by default
+        return;
+    }
+    host_TrapAddress=Address-host_sfrTrapped;
+    host_TrapOld=*Address;
+    host_protect(false);
+    ((ucontext_t*)Context)->uc_mcontext.gregs[REG_EFL] |= HOST_TRAP_FLAG;
+}
+
+
+// Single step : end of a trapped write, or an instruction of host_step
+static void host_onTrap(int, siginfo_t*, void* Context)
+{
+    greg_t* Flags=&((ucontext_t*)Context)->uc_mcontext.gregs[REG_EFL];
+    if (host_TrapAddress>=0)
+    {
+        host_applyWrite(host_TrapAddress, host_TrapOld);
+        host_TrapAddress=-1;
+        host_protect(true);
+        if (!host_OnStep) *Flags &= ~HOST_TRAP_FLAG;
+    }
+    if (host_OnStep) host_OnStep(host_Steps++);
+}
+
+
+// Print a frame (candump format, simulated time in seconds)
+static void host_printFrame(const host_can_frame_t* Frame)
+{
+    printf("(%.6f) %03X [%u]", (double)host_Time/F_CPU, Frame->id, Frame->dlc);
+    if (Frame->remote) printf(" remote");
+    else for (uint8_t i=0; i<Frame->dlc; i++) printf(" %02X", Frame->data[i]);
+    printf("\n");
+}
+
+
+// Power-on state before main, time limit from the environment
+__attribute__((constructor)) static void host_powerOn()
+{
+    if (sysconf(_SC_PAGESIZE)!=HOST_PAGE_SIZE)
+    {
+        fprintf(stderr, "host: page size is not %u bytes\n", HOST_PAGE_SIZE);
+        abort();
+    }
+    struct sigaction Action;
+    memset(&Action, 0, sizeof(Action));
+    Action.sa_flags=SA_SIGINFO;
+    Action.sa_sigaction=host_onWriteFault;
+    sigaction(SIGSEGV, &Action, 0);
+    Action.sa_sigaction=host_onTrap;
+    sigaction(SIGTRAP, &Action, 0);
+
+    host_reset();
+    const char* Limit=getenv(HOST_TIME_LIMIT_ENV);
+    if (Limit) host_TimeLimit=strtoull(Limit, 0, 10)*(F_CPU/1000);
+}
+
+
+
+
+// Power-on state
+void host_reset()
+{
+    memset((void*)host_sfr, 0, sizeof(host_sfr));
+    host_protect(false);
+    memset((void*)host_sfrTrapped, 0, sizeof(host_sfrTrapped));
+    host_protect(true);
+    memset((void*)host_Mobs, 0, sizeof(host_Mobs));
+    memset(host_PinInputs, 0, sizeof(host_PinInputs));
+    host_Pending=0;
+    host_Served=0;
+    host_ServedAtSleepEnable=0;
+    host_Time=0;
+    host_Phase=0;
+
+    PLLCSR=(1<<PLOCK);                          // The PLL locks at once
+    MCUSR=(1<<PORF);                            // Power-on reset
+}
+
+
+// Raise an interrupt
+void host_interrupt(uint8_t Vector)
+{
+    if (Vector==0 || Vector>=_VECTORS_SIZE) return;
+    host_Pending |= (1UL<<Vector);
+    host_dispatch();
+}
+
+
+// Advance the simulated time
+void host_advance(uint64_t Cycles)
+{
+    while (Cycles>0)
+    {
+        uint16_t Prescaler=host_prescaler();
+        if (Prescaler==0)
+        {
+            host_Time+=Cycles;
+            return;
+        }
+        if (host_Phase>=Prescaler) host_Phase=0;
+
+        // Up to the next compare match (a whole counter period without one)
+        uint32_t Ticks=host_nextMatch();
+        if (Ticks==0) Ticks=0x10000;
+        uint64_t ToMatch=(uint64_t)Ticks*Prescaler-host_Phase;
+        if (Cycles<ToMatch)
+        {
+            uint64_t Elapsed=host_Phase+Cycles;
+            TCNT1=TCNT1+(uint16_t)(Elapsed/Prescaler);
+            host_Phase=Elapsed%Prescaler;
+            host_Time+=Cycles;
+            return;
+        }
+        TCNT1=TCNT1+(uint16_t)Ticks;
+        host_Phase=0;
+        host_Time+=ToMatch;
+        Cycles-=ToMatch;
+
+        if ((TIMSK1 & (1<<OCIE1A)) && TCNT1==OCR1A) host_Pending |= (1UL<<TIMER1_COMPA_vect_num);
+        if ((TIMSK1 & (1<<OCIE1B)) && TCNT1==OCR1B) host_Pending |= (1UL<<TIMER1_COMPB_vect_num);
+        host_dispatch();
+    }
+}
+
+
+// Simulated time
+uint64_t host_getTime()
+{
+    return host_Time;
+}
+
+
+// Levels applied on the pins of a port
+void host_setPins(uint8_t Port, uint8_t Levels)
+{
+    if (Port>=HOST_NB_PORTS) return;
+    host_PinInputs[Port]=Levels;
+    host_protect(false);
+    host_updatePins(Port);
+    host_protect(true);
+}
+
+
+// Run a function one instruction at a time
+uint32_t host_step(void (*Function)(), host_step_t OnStep)
+{
+    host_OnStep=OnStep;
+    host_Steps=0;
+    host_setTrapFlag();
+    Function();
+    host_clearTrapFlag();
+    host_OnStep=0;
+    return host_Steps;
+}
+
+
+// Deliver a received frame
+bool host_canReceive(const host_can_frame_t* Frame)
+{
+    for (uint8_t i=0; i<HOST_NB_MOBS; i++)
+    {
+        volatile uint8_t* Reg=host_Mobs[i].reg;
+        if ((Reg[HOST_CANCDMOB]>>6)!=HOST_CONMOB_RX) continue;
+
+        // Identifier and remote bit filters
+        uint16_t Tag=((uint16_t)Reg[HOST_CANIDT1]<<3) | (Reg[HOST_CANIDT2]>>5);
+        uint16_t Mask=((uint16_t)Reg[HOST_CANIDM1]<<3) | (Reg[HOST_CANIDM2]>>5);
+        if ((Frame->id ^ Tag) & Mask) continue;
+        if ((Reg[HOST_CANIDM4] & (1<<RTRMSK)) && Frame->remote!=((Reg[HOST_CANIDT4] & (1<<RTRTAG))!=0)) continue;
+
+        // The MOb is disabled until configured again
+        uint8_t Dlc=(Frame->dlc>8) ? 8 : Frame->dlc;
+        Reg[HOST_CANIDT1]=(uint8_t)(Frame->id>>3);
+        Reg[HOST_CANIDT2]=(uint8_t)((Frame->id & 0x007)<<5);
+        Reg[HOST_CANIDT4]=Frame->remote ? (1<<RTRTAG) : 0;
+        Reg[HOST_CANCDMOB]=(Reg[HOST_CANCDMOB] & 0x30) | (Frame->dlc & 0x0F);
+        if (!Frame->remote) for (uint8_t j=0; j<Dlc; j++) host_Mobs[i].msg[j]=Frame->data[j];
+        Reg[HOST_CANSTMOB] |= (1<<RXOK);
+
+        if ((CANGIE & (1<<ENIT)) && (CANGIE & (1<<ENRX)) && (CANIE2 & (1<<i))) host_interrupt(CAN_INT_vect_num);
+        return true;
+    }
+    return false;
+}
+
+
+// Complete a transmission
+bool host_canTransmit(host_can_frame_t* Frame)
+{
+    // The controller sends the lowest MOb number first, whatever the identifiers
+    uint8_t Mob=0;
+    while (Mob<HOST_NB_MOBS && (host_Mobs[Mob].reg[HOST_CANCDMOB]>>6)!=HOST_CONMOB_TX) Mob++;
+    if (Mob==HOST_NB_MOBS) return false;
+
+    volatile uint8_t* Reg=host_Mobs[Mob].reg;
+    Frame->id=((uint16_t)Reg[HOST_CANIDT1]<<3) | (Reg[HOST_CANIDT2]>>5);
+    Frame->dlc=Reg[HOST_CANCDMOB] & 0x0F;
+    if (Frame->dlc>8) Frame->dlc=8;
+    Frame->remote=(Reg[HOST_CANIDT4] & (1<<RTRTAG))!=0;
+    for (uint8_t j=0; j<8; j++) Frame->data[j]=(j<Frame->dlc) ? host_Mobs[Mob].msg[j] : 0;
+    Reg[HOST_CANCDMOB] &= 0x3F;
+    Reg[HOST_CANSTMOB] |= (1<<TXOK);
+
+    if ((CANGIE & (1<<ENIT)) && (CANGIE & (1<<ENTX)) && (CANIE2 & (1<<Mob))) host_interrupt(CAN_INT_vect_num);
+    return true;
+}
+
+
+// Bus-off
+void host_canBusOff()
+{
+    host_protect(false);
+    CANGIT |= (1<<BOFFIT);
+    host_protect(true);
+    CANGSTA |= (1<<BOFF);
+    if ((CANGIE & (1<<ENIT)) && (CANGIE & (1<<ENBOFF))) host_interrupt(CAN_INT_vect_num);
+}
+
+
+// Frames transmitted by host_sleep
+void host_setCanLog(host_can_log_t Log)
+{
+    host_CanLog=Log;
+}
+
+
+
+
+// _____________________________
+// ::: avr-libc replacements :::
+
+
+// CANMSG
+uint8_t host_canMessage(bool Write, uint8_t Value)
+{
+    uint8_t Page=CANPAGE;
+    uint8_t Mob=Page>>4;
+    uint8_t Index=Page & 0x07;
+    volatile host_mob_t* Selected=&host_Mobs[Mob<HOST_NB_MOBS ? Mob : HOST_NB_MOBS];
+    if (Write) Selected->msg[Index]=Value;
+    else Value=Selected->msg[Index];
+    if (!(Page & (1<<AINC))) CANPAGE=(Page & 0xF8) | ((Index+1) & 0x07);
+    return Value;
+}
+
+
+// CANSIT2
+uint8_t host_canStatus()
+{
+    uint8_t Status=0;
+    for (uint8_t i=0; i<HOST_NB_MOBS; i++)
+    {
+        if ((host_Mobs[i].reg[HOST_CANSTMOB] & 0x7F) && (CANIE2 & (1<<i))) Status |= (1<<i);
+    }
+    return Status;
+}
+
+
+// sei
+void host_sei()
+{
+    SREG |= (1<<SREG_I);
+    host_dispatch();
+}
+
+
+// End of an atomic block
+void host_restore(uint8_t Sreg)
+{
+    SREG=Sreg;
+    host_dispatch();
+}
+
+
+// sleep_enable : an interrupt served before sleep_cpu wakes the CPU at once (sei followed by sleep)
+void host_sleepEnable()
+{
+    SMCR |= (1<<SE);
+    host_ServedAtSleepEnable=host_Served;
+}
+
+
+// sleep_cpu : the requested transmissions complete, then the time advances to the next Timer1 compare interrupt
+void host_sleep()
+{
+    if (!(SMCR & (1<<SE)) || host_Served!=host_ServedAtSleepEnable) return;
+    if (!(SREG & (1<<SREG_I)))
+    {
+        fprintf(stderr, "host: sleep with the interrupts disabled\n");
+        exit(EXIT_FAILURE);
+    }
+
+    host_can_frame_t Frame;
+    while (host_canTransmit(&Frame))
+    {
+        if (host_CanLog) host_CanLog(&Frame);
+    }
+    if (host_Served!=host_ServedAtSleepEnable) return;
+
+    uint16_t Prescaler=host_prescaler();
+    uint32_t Ticks=host_nextMatch();
+    if (Prescaler==0 || Ticks==0)
+    {
+        fprintf(stderr, "host: sleep without wake-up interrupt\n");
+        exit(EXIT_FAILURE);
+    }
+    if (host_Phase>=Prescaler) host_Phase=0;
+    uint64_t ToMatch=(uint64_t)Ticks*Prescaler-host_Phase;
+    if (host_TimeLimit!=0 && host_Time+ToMatch>host_TimeLimit)
+    {
+        fflush(stdout);
+        exit(EXIT_SUCCESS);
+    }
+    host_advance(ToMatch);
+}
@@ -0,0 +1,128 @@
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+
+// Host build of the firmware (make host) : the sources are compiled unchanged for Linux, the headers of this folder
+// replace avr-libc. The I/O registers are a simulated register file (host_sfr), the interrupt service routines are
+// called by a dispatch shim, and the simulated time only advances through host_advance and host_sleep.
+//
+// Modelled hardware :
+//  - global interrupt flag (SREG), non-nesting interrupts, the lowest pending vector is served first
+//  - Timer1 counter (TCCR1B prescaler) with the compare A and B interrupts (TIMSK1)
+//  - CAN message objects paged by CANPAGE, CANMSG auto increment, CANSIT2, reception filters, transmission
+//    of the lowest ready MOb number first, bus-off flag (CANGIT, cleared by writing one)
+//  - I/O ports : PINx reads the pin levels (PORTx for the outputs), a one written to PINx toggles PORTx
+//  - the PLL locks at once, the reset cause is a power-on reset
+// The other interrupts (hall sensors, ADC, comparators, Timer0) are raised by the caller with host_interrupt.
+// The other flags cleared by writing one are plain memory and int is 32 bits wide (16 bits on the target).
+// The writes to the I/O ports and CANGIT are trapped (SIGSEGV, SIGTRAP) : Linux on x86-64 only, no debugger.
+
+
+// Simulated time limit of host_sleep (environment variable, milliseconds, the process exits once reached)
+#define             HOST_TIME_LIMIT_ENV     "HOST_TIME_MS"
+
+
+/*!
+ * \brief The host_can_frame_t struct   Standard CAN frame on the simulated bus
+ */
+typedef struct
+{
+    uint16_t    id;
+    uint8_t     dlc;
+    uint8_t     data[8];
+    bool        remote;
+} host_can_frame_t;
+
+/*!
+ * \brief host_step_t       Called by host_step after each instruction (in a signal handler, plain memory only)
+ */
+typedef void (*host_step_t)(uint32_t Step);
+
+/*!
+ * \brief host_can_log_t    Called for each frame transmitted by host_sleep
+ */
+typedef void (*host_can_log_t)(const host_can_frame_t* Frame);
+
+
+
+
+/*!
+ * \brief host_reset        Power-on state : registers cleared, interrupts disabled and none pending, time 0
+ *                          Called before main, the firmware variables are not reset
+ */
+void            host_reset();
+
+
+/*!
+ * \brief host_interrupt    Raise an interrupt, served at once if the interrupts are enabled (pending otherwise)
+ * \param Vector            Vector number (e.g. PCINT2_vect_num)
+ */
+void            host_interrupt(uint8_t Vector);
+
+
+/*!
+ * \brief host_advance      Advance the simulated time, Timer1 counts and raises its enabled compare interrupts
+ * \param Cycles            CPU cycles (F_CPU)
+ */
+void            host_advance(uint64_t Cycles);
+
+
+/*!
+ * \brief host_getTime      Simulated time since host_reset [CPU cycles]
+ */
+uint64_t        host_getTime();
+
+
+/*!
+ * \brief host_setPins      Levels applied by the outside on the pins of a port (read through PINx for the inputs)
+ * \param Port              0 : port B, 1 : port C, 2 : port D
+ * \param Levels            Pin levels (bit n : pin n)
+ */
+void            host_setPins(uint8_t Port, uint8_t Levels);
+
+
+/*!
+ * \brief host_step         Run a function one instruction at a time (trap flag), e.g. to inject an interrupt
+ *                          at every instruction boundary of a lock-free handoff
+ * \param Function          Function to run
+ * \param OnStep            Called after each instruction, with the instruction index
+ * \return                  Number of instructions run
+ */
+uint32_t        host_step(void (*Function)(), host_step_t OnStep);
+
+
+/*!
+ * \brief host_canReceive   Deliver a frame to the first MOb enabled for reception which accepts it
+ *                          The CAN interrupt is raised if enabled (ENIT, ENRX, CANIE2)
+ * \return                  false if no MOb accepts the frame (lost)
+ */
+bool            host_canReceive(const host_can_frame_t* Frame);
+
+
+/*!
+ * \brief host_canTransmit  Complete the transmission of the lowest MOb number enabled for transmission
+ *                          The CAN interrupt is raised if enabled (ENIT, ENTX, CANIE2)
+ * \param Frame             Destination of the transmitted frame
+ * \return                  false if no transmission is requested
+ */
+bool            host_canTransmit(host_can_frame_t* Frame);
+
+
+/*!
+ * \brief host_canBusOff    The controller enters bus-off : BOFFIT is set and the CAN interrupt raised if enabled
+ */
+void            host_canBusOff();
+
+
+/*!
+ * \brief host_setCanLog    Set the function called for the frames transmitted by host_sleep (0 : none)
+ *                          By default the frames are printed on the standard output
+ */
+void            host_setCanLog(host_can_log_t Log);
+
+
+#endif // HOST_HAL_H
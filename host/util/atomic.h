@@ -0,0 +1,26 @@
+#ifndef HOST_UTIL_ATOMIC_H
+#define HOST_UTIL_ATOMIC_H
+
+#include <avr/interrupt.h>
+
+
+// Host replacement of <util/atomic.h> : the block clears the global interrupt flag, the interrupts raised meanwhile
+// are served when it is restored (see host/hal.h)
+
+
+/*!
+ * \brief host_restore  Restore SREG at the end of an atomic block, serve the pending interrupts if enabled
+ */
+void                host_restore(uint8_t Sreg);
+
+
+static inline uint8_t __iCliRetVal(void) { cli(); return 1; }
+static inline void __iRestore(const uint8_t *Sreg) { host_restore(*Sreg); }
+static inline void __iSeiParam(const uint8_t *) { sei(); }
+
+#define ATOMIC_RESTORESTATE     uint8_t sreg_save __attribute__((__cleanup__(__iRestore))) = SREG
+#define ATOMIC_FORCEON          uint8_t sreg_save __attribute__((__cleanup__(__iSeiParam))) = 0
+#define ATOMIC_BLOCK(type)      for (type, __ToDo = __iCliRetVal(); __ToDo; __ToDo = 0)
+
+
+#endif // HOST_UTIL_ATOMIC_H
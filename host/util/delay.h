@@ -0,0 +1,12 @@
+#ifndef HOST_UTIL_DELAY_H
+#define HOST_UTIL_DELAY_H
+
+
+// Host replacement of <util/delay.h> : the busy waits return immediately
+
+
+static inline void _delay_ms(double) {}
+static inline void _delay_us(double) {}
+
+
+#endif // HOST_UTIL_DELAY_H
@@ -1,3 +1,5 @@
+#include "cantx.h"
+
 
 void initCANBus() {
 	/** 
@@ -23,6 +25,9 @@ void initCANBus() {
 
 	// CAN Highest Priority MOb register
 	CANHPMOB = 0x00; 		// Set no priority
+
+	// Transmit queue (transmit MObs, transmit & bus-off interrupts)
+	cantx_init();
 }
 
 void initCANMOBasReceiver(uint8_t mobNumber, uint32_t ID, uint8_t rtr) {
@@ -71,8 +76,7 @@ void initCANMOBasIDBandReceiver (uint8_t mobNumber, uint32_t BeginingID, uint32_
 
 	// CAN IDentifier Mask registers (see p.170)
 	AreaSize = 0x00000000 - AreaSize;
-	if (rtr) CANIDM4 = 0x00;
-	else CANIDM4 = (1 << RTRMSK);	// Enable bit comparison with the RTR
+	CANIDM4 = (1 << RTRMSK);	// Enable bit comparison with the RTR (data frames only, or remote frames only)
 	CANIDM3 = 0xFF; 				// Enable bit comparison with the IDentifier
 	CANIDM2 = (uint8_t)((AreaSize & 0x000F) << 5);
 	CANIDM1 = (uint8_t)(AreaSize >> 3);
@@ -108,25 +112,10 @@ void disableCANMOB (uint8_t mobNumber) {
  
 void sendData(uint8_t mobNumber, uint8_t ID, uint8_t dlc, uint8_t* buffer) {
 	/**
-	 * Sending data through a CAN MOB from 0 to 5. 
-	 * The Data Length Code (nb of bytes) is included between 1 and 8
+	 * Sending data through the CAN transmit queue (never blocks, see cantx_send).
+	 * The Data Length Code (nb of bytes) is included between 1 and 8.
+	 * The frame is sent by the first free transmit MOb (CANTX_MOBS), mobNumber is ignored.
 	**/
-
-	// CAN Page mob register (see p.166)
-	CANPAGE = (mobNumber << 4) & 0xF0;	// Selection of the MOb number
-
-	// CAN IDentifier Tag registers (see p.169)
-	CANIDT4 = 0x00;								// Config as data (rtr = 0)
-	CANIDT3 = 0x00;
-	CANIDT2 = (uint8_t)((ID & 0x00F) << 5);		// Configure the identifier
-	CANIDT1 = (uint8_t)(ID >> 3);				// Configure the identifier
-
-	for (uint8_t i=0; i<dlc; i++) {
-		CANPAGE &= 0xF0;			// Set the FIFO CAN Data Buffer
-		CANPAGE |= i;				// Set the FIFO CAN Data Buffer Index
-		CANMSG = buffer[i];
-	}
-	CANCDMOB = 0x40 | dlc;			// Enable transmission and specify the Data Length Code
-	
-	while ( !(CANSTMOB & (1 << TXOK)));
+	(void)mobNumber;
+	cantx_send(ID, dlc, buffer);
   }
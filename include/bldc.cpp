@@ -1,5 +1,9 @@
 #include "bldc.h"
 #include "output.h"
+#include "sine.h"
+#include "timebase.h"
+#include "profile.h"
+#include <avr/pgmspace.h>
 
 
 m32m1_pwm       pwm;
@@ -11,12 +15,172 @@ volatile int        PWM_duty_cycle=0;
 // Direction of rotation
 volatile bool       RotationCW=false;
 
+// Speed command to duty-cycle factor (Q4.12), not 1 if the counter maximum differs from BLDC_DUTY_MAX
+uint16_t            bldc_DutyScale=BLDC_DUTY_SCALE_ONE;
 
+// The PSC runs the board settings (BLDC_PWM_CONFIG) : the duty cycles are written by the fixed channel drivers
+volatile bool       bldc_BoardConfig=true;
 
-// Initialize BLDC motor
+// PWM channel currently driven with the duty cycle (BLDC_CHANNEL_NONE if the phases are not commutated)
+volatile uint8_t    bldc_ActiveChannel=BLDC_CHANNEL_NONE;
+
+// Motor enabled (phases driven)
+volatile bool       bldc_Enabled=false;
+
+// PWM configured again by bldc_setPwmFrequency, no commutation until the PSC runs (bldc_isReady)
+volatile bool       bldc_Restarting=false;
+
+// Drive mode (six-step or sinusoidal)
+volatile uint8_t    bldc_DriveMode=BLDC_DRIVE_SIXSTEP;
+
+// Phase advance enabled
+volatile bool       bldc_PhaseAdvance=false;
+
+// Hall sensors state commutated by the phase advance interrupt
+volatile uint8_t    bldc_AdvanceHall;
+
+// Sensorless commutation
+volatile uint8_t    bldc_SensorlessState=BLDC_SENSORLESS_OFF;
+uint8_t             bldc_SensorlessHall;            // Sector currently commutated (hall sensors code)
+uint8_t             bldc_FastEdges;                 // Consecutive fast hall edges
+uint16_t            bldc_CommutationTime;           // Timestamp of the last commutation
+uint16_t            bldc_ZeroCrossingTime;          // Timestamp of the last zero crossing
+uint16_t            bldc_ZeroCrossingPeriod;        // Time between the two last zero crossings
+
+// Sinusoidal drive : angle increase per timebase tick (Q8) computed at the last edge
+uint8_t             bldc_SineEdgeCount;
+uint32_t            bldc_SineAngleStep;
+
+
+// Next sector in the direction of rotation (0=CCW, 1=CW), indexed by the hall sensors
+//      CW sequence : I > II > III > IV > V > VI > I
+const uint8_t bldc_NextSector[2][8] PROGMEM =
+{
+    // Counter ClockWise
+    {0b000, BLDC_PHASE_I, BLDC_PHASE_III, BLDC_PHASE_II, BLDC_PHASE_V, BLDC_PHASE_VI, BLDC_PHASE_IV, 0b111},
+    // ClockWise
+    {0b000, BLDC_PHASE_III, BLDC_PHASE_V, BLDC_PHASE_IV, BLDC_PHASE_I, BLDC_PHASE_II, BLDC_PHASE_VI, 0b111}
+};
+
+
+// Phase advance according to the speed (edge period), from the highest speed to the lowest
+// 48 edges per round : 300 edges/s = 39 rad/s
+const bldc_advance_t bldc_AdvanceTable[BLDC_ADVANCE_STEPS] PROGMEM =
+{
+    {TIMEBASE_HZ/2400,  107},                   // > 2400 edges/s : 25 degrees
+    {TIMEBASE_HZ/1800,  85},                    // > 1800 edges/s : 20 degrees
+    {TIMEBASE_HZ/1200,  64},                    // > 1200 edges/s : 15 degrees
+    {TIMEBASE_HZ/600,   43},                    // >  600 edges/s : 10 degrees
+    {TIMEBASE_HZ/300,   21}                     // >  300 edges/s :  5 degrees
+};
+
+
+// Electrical angle of the rotor when entering each sector in the CW direction, indexed by the hall sensors
+// (the applied voltage leads the rotor by 90 degrees, the six-step vectors are at the center of the sectors)
+const uint16_t bldc_SectorAngle[8] PROGMEM =
+{
+    0,                                          // 0b000 (invalid)
+    SINE_ANGLE_90*3,                            // BLDC_PHASE_II    270
+    SINE_ANGLE_30,                              // BLDC_PHASE_IV     30
+    SINE_ANGLE_30*11,                           // BLDC_PHASE_III   330
+    SINE_ANGLE_30*5,                            // BLDC_PHASE_VI    150
+    SINE_ANGLE_30*7,                            // BLDC_PHASE_I     210
+    SINE_ANGLE_90,                              // BLDC_PHASE_V      90
+    0                                           // 0b111 (invalid)
+};
+
+
+// Commutation table indexed by the direction of rotation (0=CCW, 1=CW) and the hall sensors
+// For each phase : output configuration, channel driven with the duty cycle, channel set to 0 (low side on)
+#define BLDC_NO_STEP    {BLDC_COMMUTATION_NONE, 0, 0}
+const bldc_commutation_t bldc_CommutationTable[2][8] PROGMEM =
+{
+    // Counter ClockWise
+    {
+        BLDC_NO_STEP,                               // 0b000
+        {BLDC_SET_Q1L_Q3H, 2, 0},                   // BLDC_PHASE_II
+        {BLDC_SET_Q2L_Q1H, 0, 1},                   // BLDC_PHASE_IV
+        {BLDC_SET_Q2L_Q3H, 2, 1},                   // BLDC_PHASE_III
+        {BLDC_SET_Q3L_Q2H, 1, 2},                   // BLDC_PHASE_VI
+        {BLDC_SET_Q1L_Q2H, 1, 0},                   // BLDC_PHASE_I
+        {BLDC_SET_Q3L_Q1H, 0, 2},                   // BLDC_PHASE_V
+        BLDC_NO_STEP                                // 0b111
+    },
+    // ClockWise
+    {
+        BLDC_NO_STEP,                               // 0b000
+        {BLDC_SET_Q3L_Q1H, 0, 2},                   // BLDC_PHASE_II
+        {BLDC_SET_Q1L_Q2H, 1, 0},                   // BLDC_PHASE_IV
+        {BLDC_SET_Q3L_Q2H, 1, 2},                   // BLDC_PHASE_III
+        {BLDC_SET_Q2L_Q3H, 2, 1},                   // BLDC_PHASE_VI
+        {BLDC_SET_Q2L_Q1H, 0, 1},                   // BLDC_PHASE_I
+        {BLDC_SET_Q1L_Q3H, 2, 0},                   // BLDC_PHASE_V
+        BLDC_NO_STEP                                // 0b111
+    }
+};
+#undef BLDC_NO_STEP
+
+
+
+// Fixed channel drivers of the board settings (dead time and bound are constants)
+template<uint8_t Channel>
+using bldc_board_channel=m32m1_psc_channel<Channel, BLDC_PWM_CONFIG.deadTimeNbCycles, BLDC_PWM_CONFIG.counterMax>;
+
+
+// Set the duty cycle of a channel, called between pwm.lock and pwm.unlock
+static inline void bldc_setDutyCycle(uint8_t Channel, uint16_t DutyCycle)
+{
+    if (!bldc_BoardConfig) { pwm.setDutyCycle(Channel, DutyCycle); return; }
+    switch (Channel)
+    {
+    case 0 : bldc_board_channel<0>::setDutyCycle(DutyCycle); break;
+    case 1 : bldc_board_channel<1>::setDutyCycle(DutyCycle); break;
+    case 2 : bldc_board_channel<2>::setDutyCycle(DutyCycle); break;
+    }
+}
+
+
+// True if the settings are the board settings
+static bool bldc_isBoardConfig(const m32m1_pwm_config& config)
+{
+    return config.counterMax==BLDC_PWM_CONFIG.counterMax && config.deadTimeNbCycles==BLDC_PWM_CONFIG.deadTimeNbCycles;
+}
+
+
+// Initialize BLDC motor with the default counter maximum
 void bldc_init(unsigned char prescaler,
                unsigned char sourceClock,
                unsigned char deadTimeNumberCycles)
+{
+    bldc_init(m32m1_pwm_config{prescaler, sourceClock, deadTimeNumberCycles, PWM_COUNTER_MAX_DEFAULT});
+}
+
+
+// Initialize BLDC motor
+void bldc_init(const m32m1_pwm_config& config)
+{
+    bldc_begin(config);
+    while (!bldc_isReady());
+
+    // Enable motor (configure ports and attach interrupt)
+    bldc_enableMotor();
+
+    // Enable interrupts
+    sei();
+}
+
+
+// Speed command to duty-cycle factor of a counter maximum (Q4.12), 0 if it does not fit 16 bits
+// (counter maximum above 16 x BLDC_DUTY_MAX, or below BLDC_DUTY_MAX/4096)
+static inline uint16_t bldc_dutyScale(uint16_t CounterMax)
+{
+    uint32_t DutyScale=((uint32_t)CounterMax*BLDC_DUTY_SCALE_ONE)/BLDC_DUTY_MAX;
+    return DutyScale>0xFFFF ? 0 : DutyScale;
+}
+
+
+// Start the BLDC motor initialization, without waiting for the PLL
+void bldc_begin(const m32m1_pwm_config& config)
 {
     // Configure ports as output and set low for MOSFET Drivers (disactivate all transistors)
     Output PSCOUT0A (&PSCOUT0A_PORT,PSCOUT0A_PIN); PSCOUT0A.setLow();
@@ -26,17 +190,60 @@ void bldc_init(unsigned char prescaler,
     Output PSCOUT2A (&PSCOUT2A_PORT,PSCOUT2A_PIN); PSCOUT2A.setLow();
     Output PSCOUT2B (&PSCOUT2B_PORT,PSCOUT2B_PIN); PSCOUT2B.setLow();
 
-    // Initialize PWM module (PSC Power Stage Controller)
-    pwm.init(prescaler,sourceClock,deadTimeNumberCycles);
+    // Initialize PWM module (PSC Power Stage Controller), the board settings if the command can not be scaled
+    uint16_t DutyScale=bldc_dutyScale(config.counterMax);
+    const m32m1_pwm_config& Config=(DutyScale==0 ? BLDC_PWM_CONFIG : config);
+    pwm.begin(Config);
+    bldc_DutyScale=(DutyScale==0 ? BLDC_DUTY_SCALE_ONE : DutyScale);
+    bldc_BoardConfig=bldc_isBoardConfig(Config);
 
     // Initialize hall effect sensors
     hall_init();
+}
 
-    // Enable motor (configure ports and attach interrupt)
-    bldc_enableMotor();
 
-    // Enable interrupts
-    sei();
+// Poll the PWM start
+bool bldc_isReady()
+{
+    if (!pwm.isStarted()) return false;
+
+    if (bldc_Restarting)
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            // New settings running : commutate the current phase (the sinusoidal refresh resumes by itself)
+            bldc_Restarting=false;
+            if (bldc_Enabled && bldc_DriveMode==BLDC_DRIVE_SIXSTEP) bldc_commutation(hall_getSensors());
+        }
+    }
+    return true;
+}
+
+
+
+// Change the PWM frequency at runtime, without waiting for the PLL
+bool bldc_setPwmFrequency(uint32_t FrequencyHz, uint16_t DeadTimeNs)
+{
+    m32m1_pwm_config Config=pwm_solve(FrequencyHz, DeadTimeNs);
+    if (Config.counterMax==0) return false;
+    uint16_t DutyScale=bldc_dutyScale(Config.counterMax);
+    if (DutyScale==0) return false;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        // The duty cycle keeps the command (BLDC_DUTY_MAX scale) with the new counter maximum
+        PWM_duty_cycle=((uint32_t)PWM_duty_cycle*DutyScale)/bldc_DutyScale;
+        bldc_DutyScale=DutyScale;
+        bldc_BoardConfig=bldc_isBoardConfig(Config);
+
+        // No commutation until the PSC runs again (bldc_isReady), the outputs are disabled by the PWM configuration
+        TIMSK1 &= ~(1<<OCIE1B);
+        bldc_stopSensorless();
+        bldc_ActiveChannel=BLDC_CHANNEL_NONE;
+        bldc_Restarting=true;
+        pwm.begin(Config);
+    }
+    return true;
 }
 
 
@@ -51,6 +258,7 @@ void bldc_enableMotor()
     // Attach the commutation phase funtion to the hall effect sensors
     hall_attachInterrupt(onInterruptHallChange);
     //timer1_attachInterrupt(onInterruptTimer1);
+    bldc_Enabled=true;
     // Lock PSC module
     pwm.unlock();
 }
@@ -64,6 +272,10 @@ void bldc_disableMotor()
     // Detach the commutation phase funtion to the hall effect sensors
     hall_detachInterrupt();
     //timer1_detachInterrupt();
+    TIMSK1 &= ~(1<<OCIE1B);
+    bldc_stopSensorless();
+    bldc_Enabled=false;
+    bldc_ActiveChannel=BLDC_CHANNEL_NONE;
     // Open the bottom transistors in the H-Bridge
     PORTB &= ~((1<<PB1) | (1<<PB6) | (1<<PB7));
     // Disable PWM from pins (outputs are standard ports)
@@ -82,6 +294,10 @@ void bldc_brakeMotor()
     // Detach the commutation phase funtion to the hall effect sensors
     hall_detachInterrupt();
     //timer1_detachInterrupt();
+    TIMSK1 &= ~(1<<OCIE1B);
+    bldc_stopSensorless();
+    bldc_Enabled=false;
+    bldc_ActiveChannel=BLDC_CHANNEL_NONE;
     // Disable PWM from pins (outputs are standard ports)
     pwm.setOutputConfiguration(PWM_CONFIG_DISABLE_ALL);
     // Close the bottom transistors in the H-Bridge
@@ -98,18 +314,42 @@ void bldc_brakeMotor()
 // Set the speed of the motor
 void bldc_setSpeed(int Speed)
 {
+    int DutyCycle=abs(Speed);
+    bool CW=(Speed<0);
+
+    // Counter maximum changed at runtime : the command keeps the BLDC_DUTY_MAX scale
+    if (bldc_DutyScale!=BLDC_DUTY_SCALE_ONE) DutyCycle=((uint32_t)DutyCycle*bldc_DutyScale)>>12;
+
     // Update the expected PWM duty cycle on each channel
-    // The following instructions can not be interrupted
+    // The following instructions can not be interrupted (the hall interrupt changes the active channel)
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
         // Update PWM_Duty_cycle
-        PWM_duty_cycle=abs(Speed);
-        // Set rotation direction
-        RotationCW=(Speed<0);        
-        // Update duty cycle
-        uint8_t hall=hall_getSensors();
-        bldc_commutation(hall);
+        PWM_duty_cycle=DutyCycle;
+        uint8_t Channel=bldc_ActiveChannel;
 
+        if (bldc_DriveMode==BLDC_DRIVE_SINE)
+        {
+            // The voltages are refreshed by the Timer0 interrupt
+            RotationCW=CW;
+        }
+        else if (CW==RotationCW && Channel!=BLDC_CHANNEL_NONE)
+        {
+            // Same direction : only the duty cycle of the driven channel changes
+            pwm.lock();
+            bldc_setDutyCycle(Channel, DutyCycle);
+            pwm.unlock();
+        }
+        else
+        {
+            // Set rotation direction (cancel the scheduled commutation)
+            RotationCW=CW;
+            TIMSK1 &= ~(1<<OCIE1B);
+            bldc_stopSensorless();
+            // Full commutation
+            uint8_t hall=hall_getSensors();
+            bldc_commutation(hall);
+        }
     }    
 }
 
@@ -117,96 +357,381 @@ void bldc_setSpeed(int Speed)
 // Called on hall sensors change
 void onInterruptHallChange(uint8_t Hall)
 {    
-    bldc_commutation(Hall);
+    // The hall edges are only counted when the motor is commutated from the back-EMF
+    if (bldc_DriveMode==BLDC_DRIVE_SIXSTEP && bldc_SensorlessState==BLDC_SENSORLESS_OFF)
+    {
+        bldc_commutation(Hall);
+#if BLDC_SENSORLESS
+        if (bldc_checkSensorless(Hall)) return;
+#endif
+        if (bldc_PhaseAdvance) bldc_scheduleAdvance(Hall);
+    }
 }
 
 
-// This function manage phase commutation
-void bldc_commutation(uint8_t Hall)
+
+
+// Enable or disable the phase advance
+void bldc_setPhaseAdvance(bool Enable)
 {
-    // Lock PWM to avoid transtory unexpected changes
-    pwm.lock();
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        bldc_PhaseAdvance=Enable;
+        if (!Enable) TIMSK1 &= ~(1<<OCIE1B);
+    }
+}
+
+
+// Return true if the phase advance is enabled
+bool bldc_getPhaseAdvance()
+{
+    return bldc_PhaseAdvance;
+}
+
 
-    // Commute according to the requested rotation direction,
-    if (RotationCW)
+// Schedule the next commutation ahead of the predicted edge
+void bldc_scheduleAdvance(uint8_t Hall)
+{
+    uint8_t Direction = RotationCW ? 1 : 0;
+
+    // The motor must turn in the requested direction (the edge is not yet processed by the hall module)
+    if (pgm_read_byte(&bldc_NextSector[Direction][hall_getLastSensors()])!=Hall)
     {
-        // ClockWise
+        TIMSK1 &= ~(1<<OCIE1B);
+        return;
+    }
+
+    // Period ending with this edge, it must be consistent with the previous one (no timebase wrap around)
+    uint8_t Count;
+    uint16_t Time, PreviousPeriod;
+    hall_getEdges(&Count, &Time, &PreviousPeriod);
+    uint16_t Now=TCNT1;
+    uint16_t Period=Now-Time;
 
-        switch (Hall)
+    // Advance according to the speed
+    uint8_t Advance=0;
+    if (PreviousPeriod!=0 && (Period>>1)<PreviousPeriod)
+    {
+        for (uint8_t i=0; i<BLDC_ADVANCE_STEPS; i++)
         {
-        case BLDC_PHASE_I:
-            pwm.setOutputConfiguration(BLDC_SET_Q2L_Q1H);
-            pwm.setDutyCycle0(PWM_duty_cycle);
-            pwm.setDutyCycle1(0);
-            break;
-        case BLDC_PHASE_II:
-            pwm.setOutputConfiguration(BLDC_SET_Q3L_Q1H);
-            pwm.setDutyCycle0(PWM_duty_cycle);
-            pwm.setDutyCycle2(0);
-            break;
-        case BLDC_PHASE_III:
-            pwm.setOutputConfiguration(BLDC_SET_Q3L_Q2H);
-            pwm.setDutyCycle1(PWM_duty_cycle);
-            pwm.setDutyCycle2(0);
-            break;
-        case BLDC_PHASE_IV:
-            pwm.setOutputConfiguration(BLDC_SET_Q1L_Q2H);
-            pwm.setDutyCycle0(0);
-            pwm.setDutyCycle1(PWM_duty_cycle);
-            break;
-        case BLDC_PHASE_V:
-            pwm.setOutputConfiguration(BLDC_SET_Q1L_Q3H);
-            pwm.setDutyCycle0(0);
-            pwm.setDutyCycle2(PWM_duty_cycle);
-            break;
-        case BLDC_PHASE_VI:
-            pwm.setOutputConfiguration(BLDC_SET_Q2L_Q3H);
-            pwm.setDutyCycle1(0);
-            pwm.setDutyCycle2(PWM_duty_cycle);
-            break;
+            if (Period<=pgm_read_word(&bldc_AdvanceTable[i].maxPeriod))
+            {
+                Advance=pgm_read_byte(&bldc_AdvanceTable[i].advance);
+                break;
+            }
         }
+    }
+    if (Advance==0)
+    {
+        TIMSK1 &= ~(1<<OCIE1B);
+        return;
+    }
+
+    // The next edge is expected one period later, commutate Advance/256 period before
+    bldc_AdvanceHall=pgm_read_byte(&bldc_NextSector[Direction][Hall]);
+    OCR1B = Now + Period - (uint16_t)(((uint32_t)Period*Advance)>>8);
+    TIFR1 = (1<<OCF1B);
+    TIMSK1 |= (1<<OCIE1B);
+}
+
+
+// Phase advance : commutation ahead of the predicted hall edge (one shot)
+// Sensorless : commutation 30 degrees after the zero crossing, or zero crossing timeout
+ISR(TIMER1_COMPB_vect)
+{
+    PROFILE_ISR_EVENT(PROFILE_COMMUTATION, OCR1B);
+    TIMSK1 &= ~(1<<OCIE1B);
+    if (!bldc_Enabled || bldc_DriveMode!=BLDC_DRIVE_SIXSTEP) return;
+#if BLDC_SENSORLESS
+    if (bldc_SensorlessState!=BLDC_SENSORLESS_OFF)
+    {
+        bldc_onSensorlessTimer();
+        return;
+    }
+#endif
+    bldc_commutation(bldc_AdvanceHall);
+}
+
+
+
+
+// Return true if the motor is commutated from the back-EMF
+bool bldc_isSensorless()
+{
+    return bldc_SensorlessState!=BLDC_SENSORLESS_OFF;
+}
+
+
+#if BLDC_SENSORLESS
+
+// Enable the comparator of the floating phase of the sector, triggered on the expected back-EMF edge
+static void bldc_armComparator(uint8_t Hall)
+{
+    uint8_t Direction = RotationCW ? 1 : 0;
+    const bldc_commutation_t* Step=&bldc_CommutationTable[Direction][Hall];
+    uint8_t Floating=3-pgm_read_byte(&Step->activeChannel)-pgm_read_byte(&Step->zeroChannel);
+
+    // The floating phase rises if it is driven high in the next sector, it falls otherwise
+    uint8_t Next=pgm_read_byte(&bldc_NextSector[Direction][Hall]);
+    bool Rising=(pgm_read_byte(&bldc_CommutationTable[Direction][Next].activeChannel)==Floating);
+
+    // Only one comparator enabled (AC0CON, AC1CON and AC2CON are consecutive registers)
+    AC0CON = 0x00;
+    AC1CON = 0x00;
+    AC2CON = 0x00;
+    ACSR = (1<<AC0IF)|(1<<AC1IF)|(1<<AC2IF);
+    (&AC0CON)[Floating] = (1<<AC0EN) | (1<<AC0IE) | (1<<AC0IS1) | (Rising ? (1<<AC0IS0) : 0) | BLDC_COMPARATOR_NEGATIVE_INPUT;
+}
 
 
+// Watchdog : the zero crossing must be detected within two sector periods
+static void bldc_startZeroCrossingTimeout(uint16_t Now)
+{
+    OCR1B = Now + 2*bldc_ZeroCrossingPeriod;
+    TIFR1 = (1<<OCF1B);
+    TIMSK1 |= (1<<OCIE1B);
+}
+
+
+// Handover from the hall sensors to the back-EMF, called on hall edges (already commutated)
+bool bldc_checkSensorless(uint8_t Hall)
+{
+    // Only when the motor turns fast enough in the requested direction
+    uint8_t Count;
+    uint16_t Time, Period;
+    hall_getEdges(&Count, &Time, &Period);
+    uint16_t Now=TCNT1;
+    uint8_t Direction = RotationCW ? 1 : 0;
+    if (pgm_read_byte(&bldc_NextSector[Direction][hall_getLastSensors()])!=Hall || (uint16_t)(Now-Time)>(uint16_t)BLDC_SENSORLESS_ENTER_PERIOD)
+    {
+        bldc_FastEdges=0;
+        return false;
+    }
+    if (++bldc_FastEdges<BLDC_SENSORLESS_ENTER_EDGES) return false;
+
+    // The hall edge is the start of the sector, the zero crossing is expected in the middle
+    bldc_SensorlessHall=Hall;
+    bldc_CommutationTime=Now;
+    bldc_ZeroCrossingPeriod=Now-Time;
+    bldc_ZeroCrossingTime=Now-(bldc_ZeroCrossingPeriod>>1);
+    bldc_SensorlessState=BLDC_SENSORLESS_WAIT_ZC;
+    bldc_armComparator(Hall);
+    bldc_startZeroCrossingTimeout(Now);
+    return true;
+}
+
+
+// Back to the hall sensors commutation
+void bldc_stopSensorless()
+{
+    AC0CON = 0x00;
+    AC1CON = 0x00;
+    AC2CON = 0x00;
+    bldc_FastEdges=0;
+    bldc_SensorlessState=BLDC_SENSORLESS_OFF;
+}
+
+
+// Zero crossing of the floating phase
+void bldc_onZeroCrossing()
+{
+    uint16_t Now=TCNT1;
+    if (bldc_SensorlessState!=BLDC_SENSORLESS_WAIT_ZC) return;
+
+    // Blanking : ignore the demagnetization of the phase just after the commutation
+    if ((uint16_t)(Now-bldc_CommutationTime)<(bldc_ZeroCrossingPeriod>>2)) return;
+
+    uint16_t Period=Now-bldc_ZeroCrossingTime;
+    bldc_ZeroCrossingTime=Now;
+    if (Period>(uint16_t)BLDC_SENSORLESS_EXIT_PERIOD)
+    {
+        // Too slow, the hall sensors take over
+        bldc_stopSensorless();
+        TIMSK1 &= ~(1<<OCIE1B);
+        bldc_commutation(hall_getSensors());
+        return;
+    }
+    bldc_ZeroCrossingPeriod=Period;
+
+    // Commutate 30 degrees (half a sector) after the zero crossing
+    AC0CON = 0x00;
+    AC1CON = 0x00;
+    AC2CON = 0x00;
+    bldc_SensorlessState=BLDC_SENSORLESS_WAIT_COMMUTATION;
+    OCR1B = Now + (Period>>1);
+    TIFR1 = (1<<OCF1B);
+    TIMSK1 |= (1<<OCIE1B);
+}
+
+
+// Timer1 compare B in sensorless mode
+void bldc_onSensorlessTimer()
+{
+    if (bldc_SensorlessState==BLDC_SENSORLESS_WAIT_COMMUTATION)
+    {
+        // Commutate to the next sector and wait for its zero crossing
+        uint16_t Now=TCNT1;
+        bldc_SensorlessHall=pgm_read_byte(&bldc_NextSector[RotationCW ? 1 : 0][bldc_SensorlessHall]);
+        bldc_commutation(bldc_SensorlessHall);
+        bldc_CommutationTime=Now;
+        bldc_SensorlessState=BLDC_SENSORLESS_WAIT_ZC;
+        bldc_armComparator(bldc_SensorlessHall);
+        bldc_startZeroCrossingTimeout(Now);
     }
     else
     {
+        // Zero crossing lost, the hall sensors take over
+        bldc_stopSensorless();
+        bldc_commutation(hall_getSensors());
+    }
+}
+
+
+// Analog comparators of the phases 0, 1 and 2 (only the comparator of the floating phase is enabled)
+ISR(ANACOMP0_vect)
+{
+    PROFILE_ISR(PROFILE_COMPARATOR);
+    bldc_onZeroCrossing();
+}
+ISR(ANACOMP1_vect, ISR_ALIASOF(ANACOMP0_vect));
+ISR(ANACOMP2_vect, ISR_ALIASOF(ANACOMP0_vect));
 
-        // Counter ClockWise
+#else
 
-        switch (Hall)
+// Sensorless commutation not available
+bool bldc_checkSensorless(uint8_t) { return false; }
+void bldc_stopSensorless() {}
+void bldc_onSensorlessTimer() {}
+void bldc_onZeroCrossing() {}
+
+#endif
+
+
+
+
+// Select the drive mode
+void bldc_setDriveMode(uint8_t Mode)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (Mode==BLDC_DRIVE_SINE)
+        {
+            // No phase advance nor sensorless commutation in sinusoidal mode
+            TIMSK1 &= ~(1<<OCIE1B);
+            bldc_stopSensorless();
+            // Timer0 : CTC mode, prescaler 64 (250kHz), compare interrupt at BLDC_SINE_UPDATE_HZ
+            bldc_SineEdgeCount=0;
+            bldc_SineAngleStep=0;
+            TCCR0A = (1<<WGM01);
+            TCCR0B = (1<<CS01)|(1<<CS00);
+            OCR0A  = F_CPU/64/BLDC_SINE_UPDATE_HZ-1;
+            TIMSK0 |= (1<<OCIE0A);
+            bldc_DriveMode=BLDC_DRIVE_SINE;
+        }
+        else
         {
-        case BLDC_PHASE_IV:
-            pwm.setOutputConfiguration(BLDC_SET_Q2L_Q1H);
-            pwm.setDutyCycle0(PWM_duty_cycle);
-            pwm.setDutyCycle1(0);
-            break;
-        case BLDC_PHASE_V:
-            pwm.setOutputConfiguration(BLDC_SET_Q3L_Q1H);
-            pwm.setDutyCycle0(PWM_duty_cycle);
-            pwm.setDutyCycle2(0);
-            break;
-        case BLDC_PHASE_VI:
-            pwm.setOutputConfiguration(BLDC_SET_Q3L_Q2H);
-            pwm.setDutyCycle1(PWM_duty_cycle);
-            pwm.setDutyCycle2(0);
-            break;
-        case BLDC_PHASE_I:
-            pwm.setOutputConfiguration(BLDC_SET_Q1L_Q2H);
-            pwm.setDutyCycle0(0);
-            pwm.setDutyCycle1(PWM_duty_cycle);
-            break;
-        case BLDC_PHASE_II:
-            pwm.setOutputConfiguration(BLDC_SET_Q1L_Q3H);
-            pwm.setDutyCycle0(0);
-            pwm.setDutyCycle2(PWM_duty_cycle);
-            break;
-        case BLDC_PHASE_III:
-            pwm.setOutputConfiguration(BLDC_SET_Q2L_Q3H);
-            pwm.setDutyCycle1(0);
-            pwm.setDutyCycle2(PWM_duty_cycle);
-            break;
+            // Stop the sinusoidal refresh and commutate according to the current phase
+            TIMSK0 &= ~(1<<OCIE0A);
+            TCCR0B = 0x00;
+            bldc_DriveMode=BLDC_DRIVE_SIXSTEP;
+            if (bldc_Enabled) bldc_commutation(hall_getSensors());
         }
     }
+}
+
+
+// Return the drive mode
+uint8_t bldc_getDriveMode()
+{
+    return bldc_DriveMode;
+}
+
+
+// This function manage phase commutation
+void bldc_commutation(uint8_t Hall)
+{
+    // Commute according to the requested rotation direction and the current phase
+    const bldc_commutation_t* Step=&bldc_CommutationTable[RotationCW ? 1 : 0][Hall & 0b111];
+    uint8_t Config=pgm_read_byte(&Step->outputConfiguration);
+
+    // Invalid sensor combination or PWM restarting, nothing to do
+    if (Config==BLDC_COMMUTATION_NONE || bldc_Restarting) { bldc_ActiveChannel=BLDC_CHANNEL_NONE; return; }
+
+    // Lock PWM to avoid transtory unexpected changes
+    pwm.lock();
+
+    pwm.setOutputConfiguration(Config);
+    uint8_t Channel=pgm_read_byte(&Step->activeChannel);
+    bldc_ActiveChannel=Channel;
+    bldc_setDutyCycle(Channel, PWM_duty_cycle);
+    bldc_setDutyCycle(pgm_read_byte(&Step->zeroChannel), 0);
+
     // Unlock PWM all the updated parameters are set simultaneously
     pwm.unlock();
 }
+
+
+
+
+// Refresh the phase voltages (sinusoidal drive)
+void bldc_sineUpdate()
+{
+    if (!bldc_Enabled || bldc_Restarting) return;
+
+    // Sector processed by the last hall edge
+    uint8_t Hall=hall_getLastSensors();
+    if (Hall==0b000 || Hall==0b111) return;
+    uint16_t Angle=pgm_read_word(&bldc_SectorAngle[Hall]);
+
+    // Angle increase per timebase tick, computed once per edge
+    uint8_t Count;
+    uint16_t Time, Period;
+    hall_getEdges(&Count, &Time, &Period);
+    if (Count!=bldc_SineEdgeCount)
+    {
+        bldc_SineEdgeCount=Count;
+        bldc_SineAngleStep = (Period==0) ? 0 : ((uint32_t)SINE_ANGLE_60<<8)/Period;
+    }
+
+    // Interpolate the position in the sector (center of the sector if the speed is unknown)
+    uint16_t Offset=SINE_ANGLE_30;
+    if (bldc_SineAngleStep!=0)
+    {
+        uint16_t Elapsed=TCNT1-Time;
+        Offset = (Elapsed>=Period) ? SINE_ANGLE_60 : (uint16_t)(((uint32_t)Elapsed*bldc_SineAngleStep)>>8);
+    }
+    if (hall_getDirection()==HALL_DIRECTION_CW) Angle+=Offset;
+    else Angle+=SINE_ANGLE_60-Offset;
+
+    // The voltage leads the rotor by 90 degrees in the requested direction
+    if (RotationCW) Angle+=SINE_ANGLE_90;
+    else Angle-=SINE_ANGLE_90;
+
+    // Amplitude : PWM_duty_cycle is the peak line voltage (duty/sqrt(3) per phase)
+    int16_t Amplitude=((int32_t)PWM_duty_cycle*18919)>>15;
+    int16_t V0=((int32_t)Amplitude*cosine_q15(Angle))>>15;
+    int16_t V1=((int32_t)Amplitude*cosine_q15(Angle-SINE_ANGLE_120))>>15;
+    int16_t V2=((int32_t)Amplitude*cosine_q15(Angle-SINE_ANGLE_240))>>15;
+
+    // Min-max injection (space vector PWM) centered on half the counter
+    int16_t Max=V0, Min=V0;
+    if (V1>Max) Max=V1;
+    if (V1<Min) Min=V1;
+    if (V2>Max) Max=V2;
+    if (V2<Min) Min=V2;
+    int16_t Center=(pwm.getCounterMax()>>1)-((Max+Min)>>1);
+
+    // All the channels are complementary PWM, updated simultaneously
+    pwm.lock();
+    pwm.setOutputConfiguration(BLDC_SET_ALL_PWM);
+    pwm.setDutyCycles(Center+V0, Center+V1, Center+V2);
+    pwm.unlock();
+}
+
+
+// Sinusoidal drive refresh
+ISR(TIMER0_COMPA_vect)
+{
+    PROFILE_ISR(PROFILE_SINE);
+    bldc_sineUpdate();
+}
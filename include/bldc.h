@@ -1,6 +1,7 @@
 #ifndef BLDC_H
 #define BLDC_H
 
+#include "config.h"
 #include <stdlib.h>
 #include "hall.h"
 #include "m32m1_pwm.h"
@@ -23,6 +24,72 @@
 #define         BLDC_SET_Q1L_Q2H        0b001110
 #define         BLDC_SET_Q1L_Q3H        0b110010
 #define         BLDC_SET_Q2L_Q3H        0b111000
+#define         BLDC_SET_ALL_PWM        0b111111
+
+// No commutation (invalid hall sensors combination)
+#define         BLDC_COMMUTATION_NONE   0xFF
+
+// No active channel (the phases are not commutated)
+#define         BLDC_CHANNEL_NONE       0xFF
+
+
+// Drive modes
+#define         BLDC_DRIVE_SIXSTEP      0       // Trapezoidal drive, commutation on hall edges (default)
+#define         BLDC_DRIVE_SINE         1       // Sinusoidal drive (space vector PWM), angle interpolated between hall edges
+
+// Refresh rate of the sinusoidal drive (Timer0 compare interrupt, 250kHz/125)
+#define         BLDC_SINE_UPDATE_HZ     2000
+
+// PSC settings of the board (config.h), solved at compile time
+constexpr m32m1_pwm_config BLDC_PWM_CONFIG = pwm_solve(PWM_FREQUENCY_HZ, PWM_DEADTIME_NS);
+static_assert(BLDC_PWM_CONFIG.counterMax!=0, "PWM_FREQUENCY_HZ and PWM_DEADTIME_NS can not be reached by the PSC");
+
+// Duty-cycle scale of the speed command : bldc_setSpeed takes a value in [-BLDC_DUTY_MAX, BLDC_DUTY_MAX]
+// When the frequency is changed at runtime, the command is rescaled to the new counter maximum
+#define         BLDC_DUTY_MAX           (BLDC_PWM_CONFIG.counterMax)
+
+// Duty-cycle rescaling factor when the counter maximum is BLDC_DUTY_MAX (Q4.12)
+#define         BLDC_DUTY_SCALE_ONE     4096
+
+// Number of steps in the phase advance table
+#define         BLDC_ADVANCE_STEPS      5
+
+
+// Sensorless commutation (BLDC_SENSORLESS=1, six-step drive only)
+// Hall edge period (timebase ticks) below which the sensorless commutation takes over
+#define         BLDC_SENSORLESS_ENTER_PERIOD    (TIMEBASE_HZ/1500)
+// Number of consecutive hall edges faster than BLDC_SENSORLESS_ENTER_PERIOD before the handover
+#define         BLDC_SENSORLESS_ENTER_EDGES     12
+// Zero crossing period (timebase ticks) above which the hall commutation takes over again (hysteresis)
+#define         BLDC_SENSORLESS_EXIT_PERIOD     (TIMEBASE_HZ/1000)
+// Comparators negative input (ACnM bits) : analog comparator negative input pin (neutral point)
+#define         BLDC_COMPARATOR_NEGATIVE_INPUT  0b100
+
+// Sensorless states
+#define         BLDC_SENSORLESS_OFF             0       // Hall commutation
+#define         BLDC_SENSORLESS_WAIT_ZC         1       // Waiting for the back-EMF zero crossing of the floating phase
+#define         BLDC_SENSORLESS_WAIT_COMMUTATION 2      // Zero crossing detected, commutation scheduled 30 degrees later
+
+
+/*!
+ * \brief The bldc_advance_t struct     One entry of the phase advance table
+ */
+typedef struct
+{
+    uint16_t    maxPeriod;              // Hall edge period (timebase ticks) below which the entry applies
+    uint8_t     advance;                // Commutation advance (1/256 of a sector : 60/256 degrees)
+} bldc_advance_t;
+
+
+/*!
+ * \brief The bldc_commutation_t struct     One entry of the commutation table
+ */
+typedef struct
+{
+    uint8_t     outputConfiguration;    // PSC output configuration (POC register)
+    uint8_t     activeChannel;          // PWM channel driven with the duty cycle
+    uint8_t     zeroChannel;            // PWM channel set to a null duty cycle (low side on)
+} bldc_commutation_t;
 
 
 
@@ -45,9 +112,49 @@
  * \param deadTimeNumberCycles   Set the number of cycles for the dead-time. The duration of one cycle is given
  *                               by the period of the sourceClock divied by the prescaler. (One eleemntary cycle)
  */
-void bldc_init(unsigned char prescaler=PWM_PRESCALER_NONE,
-               unsigned char sourceClock=PWM_SOURCE_CLK_PLL_64MHZ,
-               unsigned char deadTimeNumberCycles=PWM_DEADTIME_DEFAULT_NB_CYCLES);
+void bldc_init(unsigned char prescaler,
+               unsigned char sourceClock,
+               unsigned char deadTimeNumberCycles);
+
+
+/*!
+ * \brief bldc_init             Initilize BLDC motor (initialize PWM, and hall effect sensors)
+ * \param config                PSC settings (see pwm_solve), the board settings by default
+ *                              (PWM_FREQUENCY_HZ and PWM_DEADTIME_NS in config.h)
+ */
+void bldc_init(const m32m1_pwm_config& config=BLDC_PWM_CONFIG);
+
+
+/*!
+ * \brief bldc_begin            Non-blocking initialization : configure the PWM, start the PLL and initialize
+ *                              the hall effect sensors. The motor is not enabled and interrupts are untouched :
+ *                              poll bldc_isReady, then call bldc_enableMotor
+ * \param config                PSC settings (see pwm_solve), the board settings by default
+ *                              (also used if the counter maximum is above 16 x BLDC_DUTY_MAX)
+ */
+void bldc_begin(const m32m1_pwm_config& config=BLDC_PWM_CONFIG);
+
+
+/*!
+ * \brief bldc_isReady          Poll the non-blocking initialization or frequency change (starts the PSC when the
+ *                              PLL is locked, then commutates the phases again after bldc_setPwmFrequency)
+ * \return                      true if the PWM is running and the motor can be enabled
+ */
+bool bldc_isReady();
+
+
+/*!
+ * \brief bldc_setPwmFrequency  Change the switching frequency and the dead time at runtime, without blocking
+ *                              The PSC settings are solved at runtime and the PWM is configured again with the
+ *                              outputs disabled : poll bldc_isReady, the phases are commutated again once the
+ *                              PSC runs (the PLL may need to lock again)
+ *                              The speed command scale is kept : BLDC_DUTY_MAX is the full duty-cycle
+ * \param FrequencyHz           Switching frequency [Hz]
+ * \param DeadTimeNs            Dead time [ns]
+ * \return                      false if the frequency can not be reached, or if the counter maximum is above
+ *                              16 x BLDC_DUTY_MAX (command scale out of Q4.12, settings unchanged)
+ */
+bool bldc_setPwmFrequency(uint32_t FrequencyHz, uint16_t DeadTimeNs);
 
 
 
@@ -75,14 +182,65 @@ void bldc_brakeMotor();
 /*!
  * \brief bldc_setSpeed Set the speed of the motor
  * \param Speed         Speed of the motor (PWM duty cycle)
- *                      Speed is included between -PWM_COUNTER_MAX and +PWM_COUNTER_MAX
+ *                      Speed is included between -BLDC_DUTY_MAX and +BLDC_DUTY_MAX
  *                      Values outside of this range are bounded
+ *                      If the direction is unchanged, only the compare registers of the
+ *                      currently driven channel are updated (no commutation)
  */
 void bldc_setSpeed(int Speed);
 
 
 
 
+/*!
+ * \brief bldc_setDriveMode Select the drive mode (can be changed at runtime)
+ * \param Mode              BLDC_DRIVE_SIXSTEP : six-step trapezoidal commutation on hall edges
+ *                          BLDC_DRIVE_SINE    : the three phases are driven with sinusoidal voltages
+ *                                               (min-max injection, same line voltage as six-step at
+ *                                               full duty cycle). The rotor angle is interpolated between
+ *                                               hall edges from the last edge period and the voltages are
+ *                                               refreshed at BLDC_SINE_UPDATE_HZ by the Timer0 interrupt
+ */
+void bldc_setDriveMode(uint8_t Mode);
+
+/*!
+ * \brief bldc_getDriveMode Get the current drive mode
+ * \return                  BLDC_DRIVE_SIXSTEP or BLDC_DRIVE_SINE
+ */
+uint8_t bldc_getDriveMode();
+
+
+
+
+/*!
+ * \brief bldc_setPhaseAdvance  Enable or disable the phase advance (six-step drive only)
+ *                              When enabled, the next hall edge is predicted from the last edge period
+ *                              and the next commutation is triggered ahead of it by the Timer1 compare B
+ *                              interrupt. The advance angle depends on the speed (bldc_AdvanceTable)
+ *                              The hall edge still commutates if it comes before the compare
+ * \param Enable                 true to enable the phase advance
+ */
+void bldc_setPhaseAdvance(bool Enable);
+
+/*!
+ * \brief bldc_getPhaseAdvance  Get the phase advance state
+ * \return                      true if the phase advance is enabled
+ */
+bool bldc_getPhaseAdvance();
+
+
+
+
+/*!
+ * \brief bldc_isSensorless Get the commutation source
+ * \return                  true if the motor is commutated from the back-EMF zero crossings,
+ *                          false if it is commutated from the hall sensors
+ */
+bool bldc_isSensorless();
+
+
+
+
 /*!
  * \brief onInterruptHallChange This function is called when the hall sensor status has changed
  * \param Hall                  Current value of the sensor
@@ -91,9 +249,55 @@ void onInterruptHallChange(uint8_t Hall);
 
 /*!
  * \brief bldc_commutation  This function performs the righ commutation according to the current phase
+ *                          The PSC configuration is read from a table indexed by direction and hall sensors
  * \param Hall              Hall effect sensors : |0|0|0|0|0|H3|H2|H1|
  */
 void bldc_commutation(uint8_t Hall);
 
 
+/*!
+ * \brief bldc_scheduleAdvance  Schedule the commutation of the next sector ahead of the predicted hall edge
+ *                              Called on hall edges, before the edge is processed by the hall module
+ * \param Hall                  Current value of the sensor
+ */
+void bldc_scheduleAdvance(uint8_t Hall);
+
+
+/*!
+ * \brief bldc_checkSensorless  Count the fast hall edges and hand the commutation over to the back-EMF
+ *                              zero crossings when the motor is fast enough (called on hall edges)
+ * \param Hall                  Hall sensors state just commutated
+ * \return                      true if the sensorless commutation has started
+ */
+bool bldc_checkSensorless(uint8_t Hall);
+
+
+/*!
+ * \brief bldc_stopSensorless   Disable the comparators and go back to the hall sensors commutation
+ *                              (the caller commutates from the hall sensors if needed)
+ */
+void bldc_stopSensorless();
+
+
+/*!
+ * \brief bldc_onSensorlessTimer    Timer1 compare B in sensorless mode : scheduled commutation, or zero
+ *                                  crossing timeout (the hall sensors take over)
+ */
+void bldc_onSensorlessTimer();
+
+
+/*!
+ * \brief bldc_onZeroCrossing   Back-EMF zero crossing of the floating phase (analog comparator interrupt)
+ *                              The next commutation is scheduled half a sector period later (30 degrees)
+ *                              with the Timer1 compare B interrupt
+ */
+void bldc_onZeroCrossing();
+
+
+/*!
+ * \brief bldc_sineUpdate   Refresh the three phase voltages in sinusoidal mode (Timer0 interrupt)
+ */
+void bldc_sineUpdate();
+
+
 #endif // BLDC_H
@@ -0,0 +1,80 @@
+#include "canrtr.h"
+#include "cantx.h"
+#include "mailbox.h"
+#include <util/atomic.h>
+#include <string.h>
+
+
+
+
+// ________________________
+// ::: Global variables :::
+
+
+// Identifier of the first object
+uint16_t            canrtr_FirstId;
+
+// Snapshots, written by canrtr_update (main context) and read by the CAN interrupt
+typedef struct
+{
+    uint8_t         dlc;                    // 0 : empty object
+    uint8_t         data[8];
+} canrtr_object_t;
+
+mailbox_double<canrtr_object_t> canrtr_Objects[CANRTR_NB_OBJECTS];
+
+// Remote frames answered
+volatile uint16_t   canrtr_Requests;
+
+
+
+
+// Initialize the object table
+void canrtr_init(uint16_t FirstID)
+{
+    canrtr_object_t Empty;
+    memset(&Empty, 0, sizeof(Empty));
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        canrtr_FirstId=FirstID;
+        for (uint8_t i=0; i<CANRTR_NB_OBJECTS; i++) canrtr_Objects[i].write(Empty);
+        canrtr_Requests=0;
+    }
+}
+
+
+// Refresh an object
+void canrtr_update(uint8_t Index, uint8_t dlc, const uint8_t* Buffer)
+{
+    if (Index>=CANRTR_NB_OBJECTS) return;
+    if (dlc>8) dlc=8;
+
+    // The CAN interrupt never sees a partial copy (double buffer)
+    canrtr_object_t Object;
+    Object.dlc=dlc;
+    memcpy(Object.data, Buffer, dlc);
+    canrtr_Objects[Index].write(Object);
+}
+
+
+// Answer a remote frame (CAN interrupt)
+void canrtr_onRemoteFrame(const canrx_frame_t* Frame)
+{
+    if (!Frame->remote) return;
+    uint16_t Index=Frame->id-canrtr_FirstId;
+    if (Index>=CANRTR_NB_OBJECTS) return;
+
+    canrtr_object_t Object=canrtr_Objects[Index].read();
+    if (Object.dlc==0) return;
+    cantx_send(Frame->id, Object.dlc, Object.data);
+    canrtr_Requests++;
+}
+
+
+// Remote frames answered
+uint16_t canrtr_getRequests()
+{
+    uint16_t Requests;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { Requests=canrtr_Requests; }
+    return Requests;
+}
@@ -0,0 +1,47 @@
+#ifndef CANRTR_H
+#define CANRTR_H
+
+#include <stdint.h>
+#include "canrx.h"
+
+
+// Number of objects answered on remote frames (identifiers FirstID to FirstID+CANRTR_NB_OBJECTS-1)
+// Sized to the objects of the board : 19 bytes of RAM each (double buffer and index)
+#define             CANRTR_NB_OBJECTS       5
+
+
+
+
+/*!
+ * \brief canrtr_init   Initialize the object table, all the objects are empty (remote frames ignored)
+ * \param FirstID       Identifier of the first object
+ */
+void            canrtr_init(uint16_t FirstID);
+
+
+/*!
+ * \brief canrtr_update Refresh the snapshot of an object (main context, double buffer)
+ *                      The answer to the next remote frame is built from this copy
+ * \param Index         Object index (identifier FirstID+Index)
+ * \param dlc           Data length code (1 to 8, 0 empties the object)
+ * \param Buffer        Data bytes
+ */
+void            canrtr_update(uint8_t Index, uint8_t dlc, const uint8_t* Buffer);
+
+
+/*!
+ * \brief canrtr_onRemoteFrame  Answer a remote frame with the snapshot of its object (enqueued by cantx_send)
+ *                              canrx handler, to be registered as immediate for the object identifiers
+ *                              Data frames and empty objects are ignored
+ * \param Frame                 The received frame
+ */
+void            canrtr_onRemoteFrame(const canrx_frame_t* Frame);
+
+
+/*!
+ * \brief canrtr_getRequests    Number of remote frames answered (wraps around)
+ */
+uint16_t        canrtr_getRequests();
+
+
+#endif // CANRTR_H
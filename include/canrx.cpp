@@ -0,0 +1,151 @@
+#include "canrx.h"
+#include <avr/io.h>
+#include <util/atomic.h>
+
+
+
+
+// ________________________
+// ::: Global variables :::
+
+
+// Single producer (CAN interrupt) / single consumer (canrx_dispatch) ring
+// The producer only writes canrx_Head, the consumer only writes canrx_Tail
+canrx_frame_t       canrx_Ring[CANRX_RING_SIZE];
+volatile uint8_t    canrx_Head;
+volatile uint8_t    canrx_Tail;
+volatile uint16_t   canrx_Overruns;
+
+// Handler table
+typedef struct
+{
+    uint16_t        firstId;
+    uint16_t        lastId;
+    canrx_handler_t handler;
+    bool            immediate;
+} canrx_entry_t;
+
+canrx_entry_t       canrx_Handlers[CANRX_NB_HANDLERS];
+uint8_t             canrx_NbHandlers;
+
+
+
+
+// Initialize the ring and the handler table
+void canrx_init()
+{
+    static_assert((CANRX_RING_SIZE & (CANRX_RING_SIZE-1))==0, "CANRX_RING_SIZE must be a power of 2");
+    canrx_Head=0;
+    canrx_Tail=0;
+    canrx_Overruns=0;
+    canrx_NbHandlers=0;
+}
+
+
+// Register a handler for a range of identifiers
+bool canrx_register(uint16_t FirstID, uint16_t LastID, canrx_handler_t Handler, bool Immediate)
+{
+    if (canrx_NbHandlers>=CANRX_NB_HANDLERS) return false;
+    canrx_Handlers[canrx_NbHandlers].firstId=FirstID;
+    canrx_Handlers[canrx_NbHandlers].lastId=LastID;
+    canrx_Handlers[canrx_NbHandlers].handler=Handler;
+    canrx_Handlers[canrx_NbHandlers].immediate=Immediate;
+    canrx_NbHandlers++;
+    return true;
+}
+
+
+// Move the range of a registered handler
+bool canrx_setRange(canrx_handler_t Handler, uint16_t FirstID, uint16_t LastID)
+{
+    for (uint8_t i=0; i<canrx_NbHandlers; i++)
+    {
+        if (canrx_Handlers[i].handler!=Handler) continue;
+        canrx_Handlers[i].firstId=FirstID;
+        canrx_Handlers[i].lastId=LastID;
+        return true;
+    }
+    return false;
+}
+
+
+// Handler of an identifier, NULL if none
+static const canrx_entry_t* canrx_find(uint16_t ID)
+{
+    for (uint8_t i=0; i<canrx_NbHandlers; i++)
+    {
+        if (ID>=canrx_Handlers[i].firstId && ID<=canrx_Handlers[i].lastId) return &canrx_Handlers[i];
+    }
+    return 0;
+}
+
+
+// Drain the receive MObs (producer)
+void canrx_onInterrupt()
+{
+    uint8_t Page=CANPAGE;
+    uint16_t Now=TCNT1;
+    uint8_t Pending=CANSIT2 & CANRX_MOBS;
+
+    for (uint8_t mob=0; mob<CANRX_NB_MOBS && Pending!=0; mob++)
+    {
+        uint8_t Bit=1<<mob;
+        if (!(Pending & Bit)) continue;
+        Pending &= ~Bit;
+
+        CANPAGE = (mob << 4) & 0xF0;                // Selection of the MOb number, data index 0 (auto increment)
+        if (CANSTMOB & (1<<RXOK))
+        {
+            // The frame is written in place (the head slot is always free), then published by moving the head
+            uint8_t Head=canrx_Head;
+            canrx_frame_t* Frame=&canrx_Ring[Head];
+            Frame->id=((uint16_t)CANIDT1 << 3) | (CANIDT2 >> 5);
+            Frame->dlc=CANCDMOB & 0x0F;
+            if (Frame->dlc>8) Frame->dlc=8;
+            Frame->remote=(CANIDT4 & (1<<RTRTAG))!=0;
+            if (!Frame->remote) for (uint8_t i=0; i<Frame->dlc; i++) Frame->data[i]=CANMSG;
+            Frame->time=Now;
+
+            const canrx_entry_t* Entry=canrx_find(Frame->id);
+            uint8_t Next=(Head+1) & (CANRX_RING_SIZE-1);
+            if (Entry && Entry->immediate) Entry->handler(Frame);
+            else if (Next==canrx_Tail) canrx_Overruns++;
+            else canrx_Head=Next;
+        }
+
+        // Reset the MOb configuration for the next CAN message
+        CANSTMOB = 0x00;
+        CANCDMOB = 0x80;
+    }
+
+    CANPAGE=Page;
+}
+
+
+// Dispatch the received frames (consumer)
+uint8_t canrx_dispatch()
+{
+    uint8_t Count=0;
+    uint8_t Tail=canrx_Tail;
+    while (Tail!=canrx_Head)
+    {
+        const canrx_frame_t* Frame=&canrx_Ring[Tail];
+        const canrx_entry_t* Entry=canrx_find(Frame->id);
+        if (Entry) Entry->handler(Frame);
+
+        // The slot is released after the handler
+        Tail=(Tail+1) & (CANRX_RING_SIZE-1);
+        canrx_Tail=Tail;
+        Count++;
+    }
+    return Count;
+}
+
+
+// Frames lost
+uint16_t canrx_getOverruns()
+{
+    uint16_t Overruns;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { Overruns=canrx_Overruns; }
+    return Overruns;
+}
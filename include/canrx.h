@@ -0,0 +1,97 @@
+#ifndef CANRX_H
+#define CANRX_H
+
+#include <stdint.h>
+
+
+// Number of frames in the receive ring (power of 2)
+#define             CANRX_RING_SIZE         8
+
+// Maximum number of registered handlers
+#define             CANRX_NB_HANDLERS       8
+
+// MObs used for reception (CANEN2/CANIE2/CANSIT2 mask) : MOb1, MOb2 and MOb3
+#define             CANRX_MOBS              0b00001110
+
+// Number of MObs (ATmega32M1)
+#define             CANRX_NB_MOBS           6
+
+
+
+
+/*!
+ * \brief The canrx_frame_t struct  One received frame
+ */
+typedef struct
+{
+    uint16_t    id;                     // Standard identifier (11 bits)
+    uint8_t     dlc;                    // Data length code (0 to 8), requested length of a remote frame
+    bool        remote;                 // Remote frame (RTR, no data)
+    uint8_t     data[8];                // Data bytes (not written for a remote frame)
+    uint16_t    time;                   // Reception time (timebase ticks, 4us)
+} canrx_frame_t;
+
+
+/*!
+ * \brief canrx_handler_t   Frame handler, called by canrx_dispatch
+ * \param Frame             The received frame (valid during the call only)
+ */
+typedef void (*canrx_handler_t)(const canrx_frame_t* Frame);
+
+
+
+
+/*!
+ * \brief canrx_init    Initialize the receive ring and the handler table
+ *                      Must be called before the receive MObs are configured
+ */
+void            canrx_init();
+
+
+/*!
+ * \brief canrx_register    Register a handler for a range of identifiers (at init)
+ *                          The first registered range including the identifier is used
+ * \param FirstID           First identifier of the range
+ * \param LastID            Last identifier of the range (included)
+ * \param Handler           Function called for each frame of the range
+ * \param Immediate         false : the handler is called by canrx_dispatch
+ *                          true : the handler is called by the CAN interrupt, the frame is not queued
+ *                          (time critical frames, e.g. SYNC, the handler must be short)
+ * \return                  false if the handler table is full
+ */
+bool            canrx_register(uint16_t FirstID, uint16_t LastID, canrx_handler_t Handler, bool Immediate=false);
+
+
+/*!
+ * \brief canrx_setRange    Move the range of identifiers of a registered handler (e.g. identifiers derived from
+ *                          a node index changed at runtime). Must be called with the CAN interrupt disabled
+ * \param Handler           Registered handler (the first entry of this handler is changed)
+ * \param FirstID           New first identifier of the range
+ * \param LastID            New last identifier of the range (included)
+ * \return                  false if the handler is not registered
+ */
+bool            canrx_setRange(canrx_handler_t Handler, uint16_t FirstID, uint16_t LastID);
+
+
+/*!
+ * \brief canrx_onInterrupt Copy the frames of all the receive MObs with a pending flag into the ring
+ *                          and enable the MObs again. Must be called by the CAN interrupt (producer)
+ */
+void            canrx_onInterrupt();
+
+
+/*!
+ * \brief canrx_dispatch    Call the handlers of the frames waiting in the ring, in reception order
+ *                          Frames without handler are discarded. Must be called from a single context (consumer)
+ * \return                  The number of frames processed
+ */
+uint8_t         canrx_dispatch();
+
+
+/*!
+ * \brief canrx_getOverruns Number of frames lost because the ring was full (wraps around)
+ */
+uint16_t        canrx_getOverruns();
+
+
+#endif // CANRX_H
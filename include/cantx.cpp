@@ -0,0 +1,202 @@
+#include "cantx.h"
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <string.h>
+
+
+
+
+// ________________________
+// ::: Global variables :::
+
+
+// Queued frames, sorted by identifier from cantx_Head (ring buffer)
+cantx_frame_t       cantx_Queue[CANTX_QUEUE_SIZE];
+uint8_t             cantx_Head;
+uint8_t             cantx_Level;
+
+// Transmit MObs loaded with a frame (waiting for TXOK) and identifier of the last frame loaded
+uint8_t             cantx_MobBusy;
+uint16_t            cantx_LoadedId;
+
+// Counters
+cantx_stats_t       cantx_Stats;
+
+
+
+
+// Load a frame in a transmit MOb and request the transmission (CANPAGE is modified)
+static void cantx_loadMob(uint8_t mobNumber, const cantx_frame_t* Frame)
+{
+    CANPAGE = (mobNumber << 4) & 0xF0;          // Selection of the MOb number
+    CANSTMOB = 0x00;
+
+    CANIDT4 = 0x00;                             // Config as data (rtr = 0)
+    CANIDT3 = 0x00;
+    CANIDT2 = (uint8_t)((Frame->id & 0x007) << 5);
+    CANIDT1 = (uint8_t)(Frame->id >> 3);
+
+    for (uint8_t i=0; i<Frame->dlc; i++) {
+        CANPAGE = ((mobNumber << 4) & 0xF0) | i;    // Set the FIFO CAN Data Buffer Index
+        CANMSG = Frame->data[i];
+    }
+    CANCDMOB = 0x40 | Frame->dlc;               // Enable transmission and specify the Data Length Code
+}
+
+
+// Load the free transmit MObs with the highest priority frames (interrupts disabled, CANPAGE is modified)
+// The controller sends the lowest MOb number first, whatever the identifiers : a frame is only loaded above the
+// busy MObs, and only if its identifier is not lower than the frames already loaded
+static void cantx_loadMobs()
+{
+    for (uint8_t mob=0; mob<CANTX_NB_MOBS && cantx_Level!=0; mob++)
+    {
+        uint8_t Bit=1<<mob;
+        if (!(CANTX_MOBS & Bit) || (cantx_MobBusy & ~(Bit-1))) continue;
+        if (cantx_MobBusy && cantx_Queue[cantx_Head].id<cantx_LoadedId) return;
+        cantx_LoadedId=cantx_Queue[cantx_Head].id;
+        cantx_loadMob(mob, &cantx_Queue[cantx_Head]);
+        cantx_Head=(cantx_Head+1) & (CANTX_QUEUE_SIZE-1);
+        cantx_Level--;
+        cantx_MobBusy |= Bit;
+    }
+}
+
+
+
+
+// Initialize the queue and the transmit MObs
+void cantx_init()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        cantx_Head=0;
+        cantx_Level=0;
+        cantx_MobBusy=0;
+        memset(&cantx_Stats, 0, sizeof(cantx_Stats));
+
+        for (uint8_t mob=0; mob<CANTX_NB_MOBS; mob++)
+        {
+            if (!(CANTX_MOBS & (1<<mob))) continue;
+            CANPAGE = (mob << 4) & 0xF0;
+            CANSTMOB = 0x00;
+            CANCDMOB = 0x00;                    // MOb disabled until a frame is loaded
+        }
+        CANIE2 |= CANTX_MOBS;                   // Interrupt on TXOK
+        CANGIE |= (1<<ENTX) | (1<<ENBOFF);      // Enable transmit and bus-off interrupts
+    }
+}
+
+
+// Enqueue a frame (sorted by identifier)
+bool cantx_send(uint16_t ID, uint8_t dlc, const uint8_t* buffer)
+{
+    static_assert((CANTX_QUEUE_SIZE & (CANTX_QUEUE_SIZE-1))==0, "CANTX_QUEUE_SIZE must be a power of 2");
+    if (dlc>8) dlc=8;
+    bool Queued=true;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        uint8_t Page=CANPAGE;
+
+        // Queue full : discard the lowest priority frame (the last one, or the new one)
+        if (cantx_Level==CANTX_QUEUE_SIZE)
+        {
+            uint8_t Last=(cantx_Head+CANTX_QUEUE_SIZE-1) & (CANTX_QUEUE_SIZE-1);
+            if (cantx_Queue[Last].id<=ID)
+            {
+                cantx_Stats.dropped++;
+                Queued=false;
+            }
+            else
+            {
+                cantx_Stats.overruns++;
+                cantx_Level--;
+            }
+        }
+
+        if (Queued)
+        {
+            // Insertion from the end, the lower priority frames move back by one slot
+            uint8_t Index=(cantx_Head+cantx_Level) & (CANTX_QUEUE_SIZE-1);
+            while (Index!=cantx_Head)
+            {
+                uint8_t Previous=(Index+CANTX_QUEUE_SIZE-1) & (CANTX_QUEUE_SIZE-1);
+                if (cantx_Queue[Previous].id<=ID) break;
+                cantx_Queue[Index]=cantx_Queue[Previous];
+                Index=Previous;
+            }
+            cantx_Queue[Index].id=ID;
+            cantx_Queue[Index].dlc=dlc;
+            memcpy(cantx_Queue[Index].data, buffer, dlc);
+            if (++cantx_Level>cantx_Stats.maxLevel) cantx_Stats.maxLevel=cantx_Level;
+
+            cantx_loadMobs();
+        }
+
+        CANPAGE=Page;
+    }
+    return Queued;
+}
+
+
+// Transmit and bus-off interrupts
+void cantx_onInterrupt()
+{
+    uint8_t Page=CANPAGE;
+
+    // Bus-off : the transmissions are aborted and the queue is flushed
+    if (CANGIT & (1<<BOFFIT))
+    {
+        CANGIT = (1<<BOFFIT);                   // Clear the flag (write one)
+        cantx_Stats.busOff++;
+        cantx_Stats.dropped += cantx_Level;
+        for (uint8_t mob=0; mob<CANTX_NB_MOBS; mob++)
+        {
+            if (!(cantx_MobBusy & (1<<mob))) continue;
+            CANPAGE = (mob << 4) & 0xF0;
+            CANCDMOB = 0x00;
+            CANSTMOB = 0x00;
+            cantx_Stats.dropped++;
+        }
+        cantx_MobBusy=0;
+        cantx_Level=0;
+
+        // Enable the controller again (it joins the bus after 128 occurrences of 11 recessive bits)
+        CANGCON = (1<<ENASTB);
+    }
+
+    // Transmitted frames free their MOb (on errors the controller retries, the MOb stays busy)
+    uint8_t Pending = CANSIT2 & cantx_MobBusy;
+    for (uint8_t mob=0; mob<CANTX_NB_MOBS && Pending!=0; mob++)
+    {
+        uint8_t Bit=1<<mob;
+        if (!(Pending & Bit)) continue;
+        Pending &= ~Bit;
+        CANPAGE = (mob << 4) & 0xF0;
+        if (CANSTMOB & (1<<TXOK))
+        {
+            CANCDMOB = 0x00;
+            cantx_MobBusy &= ~Bit;
+            cantx_Stats.sent++;
+        }
+        CANSTMOB = 0x00;
+    }
+
+    cantx_loadMobs();
+    CANPAGE=Page;
+}
+
+
+// Copy of the counters
+void cantx_getStats(cantx_stats_t* Stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { *Stats=cantx_Stats; }
+}
+
+
+// Number of frames waiting
+uint8_t cantx_getLevel()
+{
+    return cantx_Level;
+}
@@ -0,0 +1,86 @@
+#ifndef CANTX_H
+#define CANTX_H
+
+#include <stdint.h>
+
+
+// Number of frames in the transmit queue
+#define             CANTX_QUEUE_SIZE        8
+
+// MObs used for transmission (CANEN2/CANIE2/CANSIT2 mask) : MOb0, MOb4 and MOb5
+#define             CANTX_MOBS              0b00110001
+
+// Number of MObs (ATmega32M1)
+#define             CANTX_NB_MOBS           6
+
+
+
+
+/*!
+ * \brief The cantx_frame_t struct  One frame of the transmit queue
+ */
+typedef struct
+{
+    uint16_t    id;                     // Standard identifier (11 bits), also the priority (lowest first)
+    uint8_t     dlc;                    // Data length code (0 to 8)
+    uint8_t     data[8];                // Data bytes
+} cantx_frame_t;
+
+
+/*!
+ * \brief The cantx_stats_t struct  Transmit queue counters (wrap around)
+ */
+typedef struct
+{
+    uint16_t    sent;                   // Frames transmitted (TXOK)
+    uint16_t    dropped;                // Frames rejected because the queue was full of higher priority frames
+    uint16_t    overruns;               // Queued frames discarded to make room for a higher priority frame
+    uint8_t     busOff;                 // Bus-off events (the queue is flushed and counted as dropped)
+    uint8_t     maxLevel;               // Highest number of frames waiting in the queue
+} cantx_stats_t;
+
+
+
+
+/*!
+ * \brief cantx_init    Initialize the transmit queue and enable the transmit and bus-off interrupts
+ *                      Must be called after initCANBus
+ */
+void            cantx_init();
+
+
+/*!
+ * \brief cantx_send    Enqueue a frame, never blocks (can be called from the main loop or an interrupt)
+ *                      The frames are sent by increasing identifier (CAN priority), frames with the same
+ *                      identifier are sent in order. A frame enqueued while frames of lower priority are
+ *                      loaded in the MObs waits for them (up to 3 frames) : the MObs are sent by number
+ *                      When the queue is full, the lowest priority frame is discarded
+ * \param ID            Standard identifier (11 bits)
+ * \param dlc           Data length code (1 to 8)
+ * \param buffer        Data bytes (copied)
+ * \return              false if the frame was discarded
+ */
+bool            cantx_send(uint16_t ID, uint8_t dlc, const uint8_t* buffer);
+
+
+/*!
+ * \brief cantx_onInterrupt Serve the transmit MObs (TXOK) and the bus-off interrupt, load the free MObs
+ *                          with the next queued frames. Must be called by the CAN interrupt
+ */
+void            cantx_onInterrupt();
+
+
+/*!
+ * \brief cantx_getStats    Get a copy of the transmit counters
+ * \param Stats             Destination of the copy
+ */
+void            cantx_getStats(cantx_stats_t* Stats);
+
+
+/*!
+ * \brief cantx_getLevel    Number of frames waiting in the queue (not yet loaded in a MOb)
+ */
+uint8_t         cantx_getLevel();
+
+
+#endif // CANTX_H
@@ -51,6 +51,67 @@ typedef uint8_t Bool;
 #define LED_YELLOW_PIN  2
 #define LED_YELLOW_POL  0
 
+/************************/
+/*    PWM               */
+/************************/
+
+// Switching frequency and dead time, the PSC settings are solved at compile time (see pwm_solve)
+// Default : 64MHz PLL, no prescaler, counter maximum 2048, 8 dead time cycles
+#define PWM_FREQUENCY_HZ        15564       // [Hz]
+#define PWM_DEADTIME_NS         125         // [ns]
+
+/************************/
+/*    CONTROL           */
+/************************/
+
+// 1: the control chain (command integration, voltage scaling, speed estimate) uses Q16.16 fixed-point
+// 0: the control chain uses soft-float (reference implementation)
+// Can be overridden at build time : make CONTROL_FIXED_POINT=0
+#ifndef CONTROL_FIXED_POINT
+#define CONTROL_FIXED_POINT     1
+#endif
+
+// 1: the speed controller commands the phase current, an inner current PI running in the ADC interrupt
+//    (one shunt conversion per PWM cycle, triggered by the PSC) computes the PWM duty-cycle
+// 0: the speed controller commands the PWM duty-cycle (voltage)
+// Can be overridden at build time : make CONTROL_CURRENT_LOOP=1
+#ifndef CONTROL_CURRENT_LOOP
+#define CONTROL_CURRENT_LOOP    0
+#endif
+
+/************************/
+/*    CURRENT SENSE     */
+/************************/
+
+// DC link shunt, measured through the differential amplifier AMP1 (AMP1+ PC5, AMP1- PC4)
+#define CURRENT_ADC_MUX         0b01111     // ADMUX MUX4:0, AMP1 output
+#define CURRENT_AMP_GAIN        (1<<AMP1G0) // AMP1CSR AMP1G1:0, gain 10
+#define CURRENT_ADC_OFFSET      512         // [ADC LSB] conversion result at zero current
+
+/************************/
+/*    SENSORLESS        */
+/************************/
+
+// 1: back-EMF sensorless commutation at high speed, using the analog comparators AC0, AC1 and AC2
+//    Requires the divided phase voltages on ACMP0/1/2 (phases 0/1/2) and the reconstructed neutral
+//    point on the comparators negative input. On the MotorBoard layout ACMP0/1/2 are the hall sensors
+//    inputs (PD7, PC6, PD5), so this option is only for boards wired for it.
+#ifndef BLDC_SENSORLESS
+#define BLDC_SENSORLESS         0
+#endif
+
+/************************/
+/*    PROFILING         */
+/************************/
+
+// 1: the interrupts are timed on entry and exit (Timer1 timebase, 4us), the CPU load, the interrupt latency
+//    and the statistics of each handler are sent in the diagnostics frame (see profile.h for the overhead)
+// 0: production build, the instrumentation is compiled out
+// Can be overridden at build time : make ENABLE_PROFILING=1
+#ifndef ENABLE_PROFILING
+#define ENABLE_PROFILING        0
+#endif
+
 //_____ D E C L A R A T I O N S ________________________________________________
 
 #endif  // _CONFIG_H_
@@ -0,0 +1,182 @@
+#include "current.h"
+#include "bldc.h"
+#include "mailbox.h"
+#include "profile.h"
+#include <util/atomic.h>
+
+
+
+
+// ________________________
+// ::: Global variables :::
+
+
+// Current samples, written in place by the ADC interrupt
+volatile int16_t    current_Samples[CURRENT_BUFFER_SIZE];
+volatile uint8_t    current_Index;
+
+// Controller gains (Q6.10), written by the main context and read by the ADC interrupt
+typedef struct
+{
+    int16_t         kp;
+    int16_t         ki;
+} current_gains_t;
+
+mailbox_double<current_gains_t> current_Gains;
+
+// Current command [ADC LSB] and voltage feedforward [PWM], written by the speed loop and read by the ADC interrupt
+typedef struct
+{
+    int16_t         command;
+    int16_t         feedforward;
+} current_setpoint_t;
+
+mailbox_double<current_setpoint_t> current_Setpoint;
+int16_t             current_Limit;
+
+// Integral term [PWM] (Q.10)
+int32_t             current_Integral;
+
+// Sign of the last output (the DC link current has the sign of the power, not of the torque)
+bool                current_OutputNegative;
+
+// Loop closed
+volatile bool       current_LoopEnabled;
+
+
+
+
+// _______________________
+// ::: Initializations :::
+
+
+// Start the conversions and initialize the controller
+void current_init(int16_t kp, int16_t ki, int16_t limit)
+{
+    current_setGains(kp, ki);
+    current_Limit=limit;
+    current_setpoint_t Setpoint={0, 0};
+    current_Setpoint.write(Setpoint);
+    current_Index=0;
+    current_enableLoop(false);
+
+    // Shunt amplifier, sampled on the ADC clock
+    AMP1CSR = (1<<AMP1EN) | CURRENT_AMP_GAIN;
+
+    // AVcc reference, right adjusted, shunt amplifier input
+    ADMUX = (1<<REFS0) | CURRENT_ADC_MUX;
+    // High speed mode, conversion started by the PSC synchronization signal
+    ADCSRB = (1<<ADHSM) | CURRENT_ADC_TRIGGER_PSC0ASY;
+    // Enable, auto trigger, interrupt, ADC clock = F_CPU/16 = 1MHz (13us conversion, shorter than a PWM cycle)
+    ADCSRA = (1<<ADEN) | (1<<ADATE) | (1<<ADIE) | (1<<ADIF) | (1<<ADPS2);
+}
+
+
+// Close or open the loop
+void current_enableLoop(bool Enable)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        current_Integral=0;
+        current_OutputNegative=false;
+        current_LoopEnabled=Enable;
+    }
+}
+
+
+
+
+// ___________________________
+// ::: Getters and setters :::
+
+
+// Update all the gains
+void current_setGains(int16_t kp, int16_t ki)
+{
+    current_gains_t Gains={kp, ki};
+    current_Gains.write(Gains);
+}
+
+void current_setKp(int16_t kp)
+{
+    current_gains_t Gains=current_Gains.read();
+    Gains.kp=kp;
+    current_Gains.write(Gains);
+}
+
+void current_setKi(int16_t ki)
+{
+    current_gains_t Gains=current_Gains.read();
+    Gains.ki=ki;
+    current_Gains.write(Gains);
+}
+
+
+// Set the current command (bounded) and the voltage feedforward
+void current_setCommand(int16_t Current, int16_t Feedforward)
+{
+    if (Current>current_Limit) Current=current_Limit;
+    if (Current<-current_Limit) Current=-current_Limit;
+    current_setpoint_t Setpoint={Current, Feedforward};
+    current_Setpoint.write(Setpoint);
+}
+
+
+// Last sample, signed as the torque
+int16_t current_getSample()
+{
+    int16_t Sample=current_Samples[current_Index];
+    return current_OutputNegative ? -Sample : Sample;
+}
+
+
+
+
+// __________________
+// ::: Controller :::
+
+
+// PI with conditional integration (the integral is frozen while the output is bounded in the same direction)
+int16_t current_update(int16_t Sample)
+{
+    current_setpoint_t Setpoint=current_Setpoint.read();
+    current_gains_t Gains=current_Gains.read();
+    int16_t Measured = current_OutputNegative ? -Sample : Sample;
+    int16_t Error = Setpoint.command - Measured;
+    if (Error>CURRENT_ERROR_MAX) Error=CURRENT_ERROR_MAX;
+    if (Error<-CURRENT_ERROR_MAX) Error=-CURRENT_ERROR_MAX;
+
+    // Unbounded command (Q.10)
+    int32_t Command = ((int32_t)Setpoint.feedforward<<10) + (int32_t)Gains.kp*Error + current_Integral;
+
+    // Bounded command, integrate only if the bound is not pushed further
+    int32_t Bound = (int32_t)CURRENT_OUTPUT_MAX<<10;
+    if (Command>Bound) Command=Bound;
+    else if (Command<-Bound) Command=-Bound;
+    else
+    {
+        current_Integral += (int32_t)Gains.ki*Error;
+        if (current_Integral>((int32_t)CURRENT_INTEGRAL_MAX<<10)) current_Integral=(int32_t)CURRENT_INTEGRAL_MAX<<10;
+        if (current_Integral<-((int32_t)CURRENT_INTEGRAL_MAX<<10)) current_Integral=-((int32_t)CURRENT_INTEGRAL_MAX<<10);
+    }
+
+    // The direction changes past the zero band only, bldc_setSpeed(0) would turn a negative direction positive
+    int16_t Output=(int16_t)(Command>>10);
+    if (current_OutputNegative ? Output>CURRENT_ZERO_BAND : Output<-CURRENT_ZERO_BAND) current_OutputNegative=!current_OutputNegative;
+    else if (current_OutputNegative && Output>=0) Output=-1;
+    else if (!current_OutputNegative && Output<0) Output=0;
+    return Output;
+}
+
+
+// End of conversion (one per PWM cycle) : the sample is written in place, then the loop is updated
+ISR(ADC_vect)
+{
+    PROFILE_ISR(PROFILE_ADC);
+    int16_t Sample=(int16_t)ADCW-CURRENT_ADC_OFFSET;
+    uint8_t Index=(current_Index+1) & (CURRENT_BUFFER_SIZE-1);
+    current_Samples[Index]=Sample;
+    current_Index=Index;
+
+    if (current_LoopEnabled) bldc_setSpeed(current_update(Sample));
+}
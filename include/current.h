@@ -0,0 +1,125 @@
+#ifndef CURRENT_H
+#define CURRENT_H
+
+#include <stdint.h>
+#include "config.h"
+#include "bldc.h"
+
+
+// ADC auto trigger source (ADCSRB ADTS3:0) : PSC module 0 synchronization signal (PSC0ASY)
+// ATmega32M1 datasheet, ADCSRB description, table "ADC Auto Trigger Source Selection" (ADTS3:0 = 1000)
+// The synchronization point is set by POCR0RA (see m32m1_pwm::init, PSC chapter "Analog Synchronization") :
+// POCR0RA=1 is at the counter bottom, the middle of one of the two half states of the center aligned period.
+// Neither the trigger nor the sampling point has been checked on the board, and no host test covers them
+#define             CURRENT_ADC_TRIGGER_PSC0ASY     0b1000
+
+// Number of samples kept by the ADC interrupt (power of 2)
+#define             CURRENT_BUFFER_SIZE             8
+
+// Output bound of the current controller, same as the bound applied by bldc_setSpeed
+#define             CURRENT_OUTPUT_MAX              BLDC_DUTY_MAX
+
+// Bound of the integral term (PWM units)
+#define             CURRENT_INTEGRAL_MAX            BLDC_DUTY_MAX
+
+// Bound of the current error (ADC LSB), keeps the products in 32 bits
+#define             CURRENT_ERROR_MAX               1024
+
+// Zero band of the output (PWM units) : the direction changes only past it (each change is a full commutation)
+#define             CURRENT_ZERO_BAND               (BLDC_DUTY_MAX/64)
+
+
+
+
+// ________________________
+// ::: Global variables :::
+
+
+// Last current samples [ADC LSB] (offset removed, positive when the DC link delivers power)
+// Written in place by the ADC interrupt, current_Index is the last written sample
+extern volatile int16_t     current_Samples[CURRENT_BUFFER_SIZE];
+extern volatile uint8_t     current_Index;
+
+
+
+
+// _______________________
+// ::: Initializations :::
+
+
+/*!
+ * \brief current_init  Start the shunt current conversions (one per PWM cycle, triggered by the PSC)
+ *                      and initialize the current controller (integral reset, loop open)
+ *                      The PWM must be initialized first
+ * \param kp            Proportional gain [PWM.LSB-1]               Q6.10
+ * \param ki            Integral gain per PWM cycle [PWM.LSB-1]     Q6.10
+ * \param limit         Current command bound [ADC LSB]
+ */
+void            current_init(int16_t kp, int16_t ki, int16_t limit);
+
+
+/*!
+ * \brief current_enableLoop    Close or open the current loop
+ *                              When closed, the ADC interrupt sets the PWM duty-cycle (bldc_setSpeed)
+ *                              When opened, the integral term is reset and the samples are only buffered
+ * \param Enable                true to close the loop
+ */
+void            current_enableLoop(bool Enable);
+
+
+
+
+// ___________________________
+// ::: Getters and setters :::
+
+
+/*!
+ * \brief current_setGains  Update the current controller gains (can be called at runtime by the main context)
+ *                          see current_init for units
+ */
+void            current_setGains(int16_t kp, int16_t ki);
+
+/*!
+ * \brief current_setKp     Update the proportional gain (Q6.10)
+ */
+void            current_setKp(int16_t kp);
+
+/*!
+ * \brief current_setKi     Update the integral gain per PWM cycle (Q6.10)
+ */
+void            current_setKi(int16_t ki);
+
+
+/*!
+ * \brief current_setCommand    Set the current command of the inner loop (called by the speed loop, main context)
+ * \param Current               Current command [ADC LSB], bounded to the limit given to current_init
+ *                              positive for CCW torque, negative for CW torque
+ * \param Feedforward           Voltage feedforward [PWM] (back-EMF compensation)
+ */
+void            current_setCommand(int16_t Current, int16_t Feedforward);
+
+
+/*!
+ * \brief current_getSample Get the last current sample
+ * \return                  The current [ADC LSB], signed as the torque (same sign as the current command)
+ */
+int16_t         current_getSample();
+
+
+
+
+// __________________
+// ::: Controller :::
+
+
+/*!
+ * \brief current_update    Compute the PWM duty-cycle from the current sample (called by the ADC interrupt)
+ *                          The output keeps its sign within CURRENT_ZERO_BAND of zero (bounded to zero, or to
+ *                          one PWM step when negative) so that the noise does not reverse the direction
+ * \param Sample            DC link current [ADC LSB], offset removed
+ * \return                  The PWM duty-cycle [-CURRENT_OUTPUT_MAX, CURRENT_OUTPUT_MAX] for bldc_setSpeed
+ */
+int16_t         current_update(int16_t Sample);
+
+
+#endif // CURRENT_H
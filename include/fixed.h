@@ -0,0 +1,91 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+
+
+// ________________________
+// ::: Q16.16 format :::
+
+// Signed fixed-point value with 16 integer bits and 16 fractional bits
+// Range is [-32768, 32768[, resolution is 1/65536 (~1.5e-5)
+typedef int32_t     q16_t;
+
+#define             Q16_FRAC_BITS           16
+#define             Q16_ONE                 ((q16_t)1<<Q16_FRAC_BITS)
+#define             Q16_MAX                 ((q16_t)0x7FFFFFFF)
+#define             Q16_MIN                 (-Q16_MAX)
+
+// Convert a constant expression to a Q-format value (rounded to nearest), evaluated at compile time
+#define             Q_FROM_CONST(x,bits)    ((int32_t)((x)*(double)(1L<<(bits)) + ((x)>=0 ? 0.5 : -0.5)))
+#define             Q16_FROM_CONST(x)       Q_FROM_CONST(x,Q16_FRAC_BITS)
+
+
+
+
+/*!
+ * \brief q16_fromFloat Convert a floating point value into Q16.16 (rounded to nearest)
+ *                      Uses soft-float, keep it out of the fast paths
+ * \param x             value to convert, must be included in the Q16.16 range
+ * \return              the Q16.16 value
+ */
+static inline q16_t q16_fromFloat(float x)
+{
+    return (q16_t)(x*(float)Q16_ONE + (x>=0 ? 0.5f : -0.5f));
+}
+
+
+/*!
+ * \brief q16_toFloat   Convert a Q16.16 value into floating point
+ *                      Uses soft-float, keep it out of the fast paths
+ * \param x             Q16.16 value
+ * \return              the floating point value
+ */
+static inline float q16_toFloat(q16_t x)
+{
+    return (float)x*(1.0f/(float)Q16_ONE);
+}
+
+
+/*!
+ * \brief q16_toInt     Integer part of a Q16.16 value, truncated toward zero
+ *                      (same rounding as a float to integer cast)
+ * \param x             Q16.16 value
+ * \return              the integer part of x
+ */
+static inline int16_t q16_toInt(q16_t x)
+{
+    return (x<0) ? -(int16_t)((-x)>>Q16_FRAC_BITS) : (int16_t)(x>>Q16_FRAC_BITS);
+}
+
+
+/*!
+ * \brief q16_clamp     Bound a Q16.16 value
+ * \param x             value to bound
+ * \param limit         the bound (positive), x is kept in [-limit, limit]
+ * \return              the bounded value
+ */
+static inline q16_t q16_clamp(q16_t x, q16_t limit)
+{
+    if (x>limit) return limit;
+    if (x<-limit) return -limit;
+    return x;
+}
+
+
+/*!
+ * \brief q16_mulQ10    Multiply a Q16.16 value by a Q6.10 gain, result is Q16.16
+ *                      The operand is first reduced to Q.8 so the product fits in 32 bits:
+ *                      |x*gain| must be lower than 8192 (e.g. |x|<1460 for a gain of 5.61)
+ *                      Absolute error is below 2^-8*|gain| + 2^-11*|x|
+ * \param x             Q16.16 value
+ * \param gain          Q6.10 gain (use Q_FROM_CONST(gain,10) for constants)
+ * \return              x*gain in Q16.16
+ */
+static inline q16_t q16_mulQ10(q16_t x, int16_t gain)
+{
+    return ((x>>8)*(int32_t)gain)>>(8+10-Q16_FRAC_BITS);
+}
+
+
+#endif // FIXED_H
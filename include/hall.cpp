@@ -1,4 +1,9 @@
 #include "hall.h"
+#include "timebase.h"
+#include "mailbox.h"
+#include "profile.h"
+#include "trace.h"
+#include <avr/pgmspace.h>
 
 
 
@@ -18,13 +23,57 @@ volatile uint8_t hall_previousSensors=0;
 // Hall sensor error
 volatile bool hall_ErrorHallSensors;
 
-// Current motor position
-volatile int64_t hall_Position;
+// Number of hall sensor errors (wraps around)
+volatile uint8_t hall_ErrorCount;
+
+// Current motor position (low 32 bits, wraps around), written by the interrupt
+// Readers retry until the sequence counter is unchanged across their copy (no interrupt masking)
+mailbox_seqlock<uint32_t> hall_Position;
+
+// Full-width position, rebuilt from the low 32 bits when requested (hall_getPosition)
+int64_t hall_PositionExtended;
+uint32_t hall_PositionLast;
+
+// Timing of the last edge, written by the interrupt
+typedef struct
+{
+    uint16_t    time;               // Timestamp of the last edge (timebase ticks)
+    uint16_t    period;             // Time between the two last edges (timebase ticks), 0 if unknown (direction change or error)
+    uint8_t     count;              // Number of edges (wraps around)
+} hall_edges_t;
+
+mailbox_seqlock<hall_edges_t> hall_Edges;
 
 
 void (*userFunction)(unsigned char)=0;
 
 
+// Transition table indexed by the previous (bits 3,4 and 5) and the current (bits 0,1 and 2) sensor values
+// Gives the position step of the transition :
+//      CW sequence :  101 > 001 > 011 > 010 > 110 > 100 > 101   (position decreases)
+//      CCW sequence : 101 > 100 > 110 > 010 > 011 > 001 > 101   (position increases)
+#define N   HALL_STEP_NONE
+#define E   HALL_STEP_ERROR
+#define CW  HALL_STEP_CW
+#define CCW HALL_STEP_CCW
+const int8_t hall_Transitions[64] PROGMEM =
+{
+//  Current :   000 001 010 011 100 101 110 111     Previous :
+                N,  E,  E,  E,  E,  E,  E,  E,      // 000
+                E,  N,  E,  CW, E,  CCW,E,  E,      // 001
+                E,  E,  N,  CCW,E,  E,  CW, E,      // 010
+                E,  CCW,CW, N,  E,  E,  E,  E,      // 011
+                E,  E,  E,  E,  N,  CW, CCW,E,      // 100
+                E,  CW, E,  E,  CCW,N,  E,  E,      // 101
+                E,  E,  CCW,E,  CW, E,  N,  E,      // 110
+                E,  E,  E,  E,  E,  E,  E,  N       // 111
+};
+#undef N
+#undef E
+#undef CW
+#undef CCW
+
+
 
 
 // _______________________
@@ -51,10 +100,14 @@ void hall_init()
     hall_Direction=0;
     // No error after initialization
     hall_ErrorHallSensors=0;
+    hall_ErrorCount=0;
     // Read sensors to initialize previous sensor value
     hall_previousSensors=hall_getSensors();
     // Reset motor position
-    hall_Position=0;
+    hall_setPosition(0);
+    // No edge yet
+    hall_edges_t Edges={0, 0, 0};
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { hall_Edges.write(Edges); }
 }
 
 
@@ -86,11 +139,14 @@ void hall_detachInterrupt()
 // Interrupt vectors, called everytime a change is detected on H2
 ISR(PCINT1_vect)
 {
+    PROFILE_ISR(PROFILE_HALL);
+
     // Get current value of hall sensors
     uint8_t currentStatus=hall_getSensors();
 
     // If an interrupt is attached, call the user function
-    if (userFunction)   (*userFunction)(currentStatus);
+    void (*function)(unsigned char)=userFunction;
+    if (function)   (*function)(currentStatus);
 
     // Update position and direction
     hall_onChange(currentStatus);
@@ -101,18 +157,8 @@ ISR(PCINT1_vect)
 
 
 // Interrupt vectors, called everytime a change is detected on H1 or H3
-ISR(PCINT2_vect)
-{
-    // Get current value of hall sensors
-    uint8_t currentStatus=hall_getSensors();
-
-    // If an interrupt is attached, call the user function
-    if (userFunction)   (*userFunction)(currentStatus);
-
-    // Update position and direction
-    hall_onChange(currentStatus);
-
-}
+// Same processing as H2 : the vector jumps directly to the PCINT1 service routine
+ISR(PCINT2_vect, ISR_ALIASOF(PCINT1_vect));
 
 
 
@@ -133,6 +179,13 @@ uint8_t hall_getSensors()
 }
 
 
+// Return the sensors processed by the last edge
+uint8_t hall_getLastSensors()
+{
+    return hall_previousSensors;
+}
+
+
 // Return the direction of rotation (0=CW 1=CCW)
 bool hall_getDirection()
 {
@@ -145,24 +198,36 @@ bool hall_getDirection()
 
 
 
+// Return the low 32 bits of the current position (sequence counter read, interrupts stay enabled)
+int32_t hall_getPosition32()
+{
+    // Copy the position shared with the interruption service routine,
+    // retry if the interrupt updated it during the copy
+    return (int32_t)hall_Position.read();
+}
+
+
 // Return the current position of the motor (number of steps)
 int64_t hall_getPosition()
 {
-    int64_t PositionCopy;
-    // The following instruction can not be interrupted
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-    {
-        // Copy the position shared with the interruption service routine
-        PositionCopy=hall_Position;
-    }
-    return PositionCopy;
+    // Extend the low 32 bits with the (signed) change since the last call
+    uint32_t PositionCopy=(uint32_t)hall_getPosition32();
+    hall_PositionExtended+=(int32_t)(PositionCopy-hall_PositionLast);
+    hall_PositionLast=PositionCopy;
+    return hall_PositionExtended;
 }
 
 
 // Set the current position
 void hall_setPosition(int64_t Position)
 {
-    hall_Position=Position;
+    // The following instruction can not be interrupted
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        hall_Position.write((uint32_t)Position);
+        hall_PositionLast=(uint32_t)Position;
+        hall_PositionExtended=Position;
+    }
 }
 
 
@@ -180,46 +245,61 @@ void hall_resetError()
 }
 
 
+// Number of errors
+uint8_t hall_getErrorCount()
+{
+    return hall_ErrorCount;
+}
+
+
+// Copy the last edge timing
+void hall_getEdges(uint8_t* Count, uint16_t* Time, uint16_t* Period)
+{
+    // Sequence counter read, the interrupts stay enabled
+    hall_edges_t Edges=hall_Edges.read();
+    *Count=Edges.count;
+    *Time=Edges.time;
+    *Period=Edges.period;
+}
+
+
 
 // Manage hall sensors (call on every sensor change)
 void hall_onChange(uint8_t currentStatus)
 {
+    // Decode the status (combination previous + current) : previous value (bits 3,4 and 5) and current value (bits 0,1 and 2)
+    int8_t Step=(int8_t)pgm_read_byte(&hall_Transitions[currentStatus | (hall_previousSensors<<3)]);
+
     // No change or insignificant transition
-    if (currentStatus==hall_previousSensors) return;
+    if (Step==HALL_STEP_NONE) return;
 
-    // Create a byte containing previous value (bits 3,4 and 5) and current value (bits 0,1 and 2)
-    unsigned char Status = currentStatus | (hall_previousSensors<<3);
+    // Timestamp the edge (Timer1 is free-running, interrupts are disabled here)
+    uint16_t edgeTime=TCNT1;
+    bool previousDirection=hall_Direction;
+    hall_edges_t Edges=hall_Edges.last();
 
-    // Analyse the status (combination previous + current)
-    switch (Status)
+    if (Step==HALL_STEP_ERROR)
+    {
+        // Error, a problem occured, report an error and keep the previous direction
+        hall_ErrorHallSensors=true;
+        hall_ErrorCount++;
+        Step=(previousDirection==HALL_DIRECTION_CCW) ? HALL_STEP_CCW : HALL_STEP_CW;
+        Edges.period=0;
+    }
+    else
     {
-        // CW
-        case 0b101001: hall_Direction=HALL_DIRECTION_CW; break;
-        case 0b001011: hall_Direction=HALL_DIRECTION_CW; break;
-        case 0b011010: hall_Direction=HALL_DIRECTION_CW; break;
-        case 0b010110: hall_Direction=HALL_DIRECTION_CW; break;
-        case 0b110100: hall_Direction=HALL_DIRECTION_CW; break;
-        case 0b100101: hall_Direction=HALL_DIRECTION_CW; break;
-
-        // CCW
-        case 0b011001: hall_Direction=HALL_DIRECTION_CCW; break;
-        case 0b010011: hall_Direction=HALL_DIRECTION_CCW; break;
-        case 0b110010: hall_Direction=HALL_DIRECTION_CCW; break;
-        case 0b100110: hall_Direction=HALL_DIRECTION_CCW; break;
-        case 0b101100: hall_Direction=HALL_DIRECTION_CCW; break;
-        case 0b001101: hall_Direction=HALL_DIRECTION_CCW; break;
-
-        // Error, a problem occured, report an error
-        default : hall_ErrorHallSensors=true;
+        hall_Direction=(Step==HALL_STEP_CCW) ? HALL_DIRECTION_CCW : HALL_DIRECTION_CW;
+        // The period is meaningful only between two consecutive sectors in the same direction
+        Edges.period=(hall_Direction==previousDirection) ? edgeTime-Edges.time : 0;
     }
+    Edges.time=edgeTime;
+    Edges.count++;
+    hall_Edges.write(Edges);
+    trace_onEdge(Edges.time, Edges.period, currentStatus, Edges.count);
 
     // Increase or decrease the position according to the direction of motion
-    if (hall_Direction==HALL_DIRECTION_CCW) hall_Position++; 
-    else hall_Position--;
+    hall_Position.write(hall_Position.last()+(int32_t)Step);
 
     // Current value becomes previous value for the next call of the function
     hall_previousSensors=currentStatus;
 }
-
-
-
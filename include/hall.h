@@ -11,6 +11,13 @@
 #define             HALL_DIRECTION_CCW      0
 
 
+// Position steps given by the transition table (see hall_onChange)
+#define             HALL_STEP_NONE          0
+#define             HALL_STEP_CCW           1
+#define             HALL_STEP_CW            -1
+#define             HALL_STEP_ERROR         2
+
+
 
 #define             HALL_1_PORT             PORTD
 #define             HALL_1_DDR              DDRD
@@ -87,8 +94,7 @@ ISR(PCINT1_vect);
 /*!
  * \brief ISR(PCINT2_vect)  Interrupt Service Routine
  *                          called on changes on sensors H1 or H3
- *                          Read hall sensors, call user function if attached
- *                          Update direction and position
+ *                          Alias of ISR(PCINT1_vect) (same code, no extra call)
  */
 ISR(PCINT2_vect);
 
@@ -106,6 +112,13 @@ ISR(PCINT2_vect);
  */
 uint8_t         hall_getSensors();
 
+/*!
+ * \brief hall_getLastSensors   get hall sensors as processed by the last edge
+ *                              (consistent with hall_getEdges, unlike hall_getSensors which reads the pins)
+ * \return                      combination of the 3 hall sensors ( |0|0|0|0|0|H3|H2|H1| )
+ */
+uint8_t         hall_getLastSensors();
+
 /*!
  * \brief hall_getDirection getter on direction of rotation (0=CW 1=CCW)
  * \return                  false if the rotation is clockwise
@@ -116,10 +129,21 @@ bool            hall_getDirection();
 /*!
  * \brief hall_getPosition  getter on the current position
  *                          The position is given in term on hall sensor changes
+ *                          The interrupt only maintains the low 32 bits, the full value is rebuilt
+ *                          from the change since the previous call (one single consumer, main loop)
  * \return                  the current position of the motor
  */
 int64_t         hall_getPosition();
 
+/*!
+ * \brief hall_getPosition32    getter on the low 32 bits of the current position
+ *                              Lock-free read (sequence counter), the interrupts are never disabled
+ *                              Can be called from any context, differences between two values
+ *                              are valid as long as they are lower than 2^31 steps
+ * \return                      the low 32 bits of the position of the motor
+ */
+int32_t         hall_getPosition32();
+
 /*!
  * \brief hall_setPosition  set the current position of the motor
  * \param Position          new current position
@@ -141,6 +165,23 @@ bool            hall_getError();
  */
 void            hall_resetError();
 
+/*!
+ * \brief hall_getErrorCount   getter on the number of hall sensor errors (not reset by hall_resetError)
+ * \return                     the number of errors since hall_init (wraps around)
+ */
+uint8_t         hall_getErrorCount();
+
+/*!
+ * \brief hall_getEdges     getter on the timing of the last edge (timestamps from the Timer1 timebase, see timebase.h)
+ *                          The timebase must be started (timebase_init)
+ * \param Count             number of edges since initialization (wraps around)
+ * \param Time              timestamp of the last edge
+ * \param Period            time between the two last edges
+ *                          0 if unknown (change of direction or sensor error)
+ *                          The value wraps around if the edges are more than 262ms apart
+ */
+void            hall_getEdges(uint8_t* Count, uint16_t* Time, uint16_t* Period);
+
 
 
 
@@ -151,6 +192,7 @@ void            hall_resetError();
 /*!
  * \brief hall_onChange This is call everytime a change occured on a sensor
  *                      compute the direction of rotation and update the position
+ *                      The transition is decoded with a single lookup in a 64 entries table (flash)
  *                      if the new value disagree with previous one, hall_ErrorHallSensors
  *                      is set to one.
  * \param currentStatus Current status of the hall sensors ( |0|0|0|0|0|H3|H2|h1|)
@@ -6,7 +6,10 @@
 
 LED::LED(volatile uint8_t * port, uint8_t pinmask, uint8_t polarity) :
     Output(port, pinmask),
-    polarity(polarity)
+    polarity(polarity),
+    blinkToggles(0),
+    blinkHalfPeriod(0),
+    blinkLast(0)
 {
     off();
 }
@@ -29,6 +32,20 @@ void LED::blink(uint16_t delay) {
     off();
 }
 
+void LED::startBlink(uint8_t count, uint16_t halfPeriod, uint16_t now) {
+    off();
+    blinkToggles=2*count;
+    blinkHalfPeriod=halfPeriod;
+    blinkLast=now;
+}
+
+void LED::update(uint16_t now) {
+    if (blinkToggles==0 || (uint16_t)(now-blinkLast)<blinkHalfPeriod) return;
+    toggle();
+    blinkLast+=blinkHalfPeriod;
+    blinkToggles--;
+}
+
 void LED::setState(uint8_t state) {
     state ? on() : off();
 }
@@ -37,6 +37,27 @@ public:
      */
     void blink(uint16_t delay=50);
 
+    /*!
+     * \brief startBlink    Start blinking the LED without blocking, the blinks are done by update
+     * \param count         Number of blinks
+     * \param halfPeriod    The on/off delay, in the time unit given to update
+     * \param now           Current time
+     */
+    void startBlink(uint8_t count, uint16_t halfPeriod, uint16_t now);
+
+    /*!
+     * \brief update        Toggle the LED when the on/off delay has elapsed (non-blocking blink)
+     *                      Must be called periodically
+     * \param now           Current time (wraps around), in the same unit as the startBlink halfPeriod
+     */
+    void update(uint16_t now);
+
+    /*!
+     * \brief isBlinking    Check if a non-blocking blink is in progress
+     * \return              true until the last blink is done
+     */
+    bool isBlinking() { return blinkToggles!=0; }
+
     /*!
      * \brief setState Set LED State (1: on, 0:off)
      * \param state State to set (1: on, 0:off)
@@ -49,6 +70,11 @@ private:
      * @note       If polarity=1, the LED is ON on a high state
      */
     uint8_t polarity;
+
+    // Non-blocking blink : remaining toggles, on/off delay and time of the last toggle
+    uint8_t blinkToggles;
+    uint16_t blinkHalfPeriod;
+    uint16_t blinkLast;
 };
 
 #endif // LED_H
@@ -2,20 +2,37 @@
 
 
 // Constructor, do nothing
-m32m1_pwm::m32m1_pwm()
+m32m1_pwm::m32m1_pwm() :
+    running(false),
+    pllSource(false)
 {}
 
 
-// Initialize the PWM device at a given frequency
+// Initialize the PWM device at a given frequency (waits for the PLL)
 void m32m1_pwm::init(uint8_t    prescaler,
                      uint8_t    sourceClock,
                      uint8_t    deadTimeNumberCycles,
                      uint16_t   counterMaximum)
+{
+    this->begin(prescaler, sourceClock, deadTimeNumberCycles, counterMaximum);
+    while (!this->isStarted());
+}
+
+
+// Configure the PWM device and start the source clock, the PSC is started by isStarted
+void m32m1_pwm::begin(uint8_t    prescaler,
+                      uint8_t    sourceClock,
+                      uint8_t    deadTimeNumberCycles,
+                      uint16_t   counterMaximum)
 {
     // Disable all the PWM channels the outpouts are standard ports
     // This to avoid cross conduction during initialization
     this->setOutputConfiguration(PWM_CONFIG_DISABLE_ALL);
 
+    // Stop the PSC (the source clock can change)
+    PCTL &= ~(1<<PRUN);
+    running=false;
+
     // Enable overlap protection
     PMIC0 &= ~(1<<POVEN0);
     PMIC1 &= ~(1<<POVEN1);
@@ -23,8 +40,18 @@ void m32m1_pwm::init(uint8_t    prescaler,
 
     // Set the requested prescaler
     this->setPrescaler(prescaler);
-    // Set the requested sourceClock
-    this->setSourceClock(sourceClock);
+    // Start the requested sourceClock (the PLL needs about 100ms to lock, see isStarted)
+    pllSource=(sourceClock!=PWM_SOURCE_CLK_CPU_CLK);
+    if (pllSource)
+    {
+        pll.setFrequency(sourceClock==PWM_SOURCE_CLK_PLL_64MHZ ? PLL_FREQUENCY_64MHZ : PLL_FREQUENCY_32MHZ);
+        pll.start();
+    }
+    else
+    {
+        pll.stop();
+        PCTL &= ~(1<<PCLKSEL);
+    }
 
     // Store the number of dead cycles
     deadTimeNbCycles=deadTimeNumberCycles;
@@ -39,50 +66,52 @@ void m32m1_pwm::init(uint8_t    prescaler,
 
     // reste the PSC Complete Cycle bit
     PCTL &= ~(1<<PCCYC);
+}
+
+
+// Start the PSC as soon as the source clock is ready
+bool m32m1_pwm::isStarted()
+{
+    if (running) return true;
+    if (pllSource)
+    {
+        if (!pll.isReady()) return false;
+        PCTL |= (1<<PCLKSEL);
+    }
 
     // Start the PSC
     PCTL |= (1<<PRUN);
+    running=true;
+    return true;
 }
 
 
 
 
-// Set the requested prescaler in register PCTL
-void m32m1_pwm::setPrescaler(uint8_t prescaler)
+// Initialize the PWM device with solved settings
+void m32m1_pwm::init(const m32m1_pwm_config& config)
 {
-    PCTL = prescaler | (PCTL & 0b00111111);
+    this->init(config.prescaler, config.sourceClock, config.deadTimeNbCycles, config.counterMax);
 }
 
 
-
-// Set source clock for the PWM device
-void m32m1_pwm::setSourceClock(uint8_t sourceClock)
+// Configure the PWM device with solved settings, without waiting for the PLL
+void m32m1_pwm::begin(const m32m1_pwm_config& config)
 {
-    // According to the requested source clock (CPU of PLL)
-    switch (sourceClock)
-    {
-    case PWM_SOURCE_CLK_CPU_CLK :
-        pll.stop();
-        PCTL &= ~(1<<PCLKSEL);
-        break;
+    this->begin(config.prescaler, config.sourceClock, config.deadTimeNbCycles, config.counterMax);
+}
 
-    case PWM_SOURCE_CLK_PLL_32MHZ :
-        pll.setFrequency(PLL_FREQUENCY_32MHZ);
-        pll.start();
-        while (!pll.isReady());
-        PCTL |= (1<<PCLKSEL);
-        break;
 
-    case PWM_SOURCE_CLK_PLL_64MHZ :
-        pll.setFrequency(PLL_FREQUENCY_64MHZ);
-        pll.start();
-        while (!pll.isReady());
-        PCTL |= (1<<PCLKSEL);
-        break;
-    }
+
+
+// Set the requested prescaler in register PCTL
+void m32m1_pwm::setPrescaler(uint8_t prescaler)
+{
+    PCTL = prescaler | (PCTL & 0b00111111);
 }
 
 
+
 // Set the maximum value for the counter (output compare match)
 void m32m1_pwm::setCounterMax(uint16_t counterMaximum)
 {
@@ -91,33 +120,3 @@ void m32m1_pwm::setCounterMax(uint16_t counterMaximum)
     // PWM maximum counter value (output compare match)
     POCR_RB=counterMax+deadTimeNbCycles-1;
 }
-
-
-// Set new duty-cycle for PWM 0
-void m32m1_pwm::setDutyCycle0(uint16_t dutyCycle)
-{    
-    if (dutyCycle>counterMax) dutyCycle=counterMax;
-    POCR0SA=dutyCycle;
-    POCR0SB=dutyCycle+deadTimeNbCycles;    
-}
-
-// Set new duty-cycle for PWM 1
-void m32m1_pwm::setDutyCycle1(uint16_t dutyCycle)
-{
-    if (dutyCycle>counterMax) dutyCycle=counterMax;
-    POCR1SA=dutyCycle;
-    POCR1SB=dutyCycle+deadTimeNbCycles;
-}
-
-// Set new duty-cycle for PWM 2
-void m32m1_pwm::setDutyCycle2(uint16_t dutyCycle)
-{
-    if (dutyCycle>counterMax) dutyCycle=counterMax;
-    POCR2SA=dutyCycle;
-    POCR2SB=dutyCycle+deadTimeNbCycles;
-}
-
-
-
-
-
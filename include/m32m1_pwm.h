@@ -43,6 +43,137 @@
 #define         PWM_COUNTER_MAX_DEFAULT         2048
 
 
+// Number of PSC cycles in half a PWM period (counter maximum + dead time) is at most 4096 (POCR_RB is 12 bits)
+#define         PWM_HALF_PERIOD_MAX_CYCLES      4096
+
+// Minimum counter maximum (duty-cycle resolution) accepted by the frequency solver
+#define         PWM_COUNTER_MAX_MIN             64
+
+// Number of (source clock, prescaler) combinations tried by the frequency solver
+#define         PWM_SOLVER_OPTIONS              12
+
+
+/*!
+ * \brief The m32m1_pwm_config struct  PSC settings for a switching frequency and a dead time
+ *                                      (see pwm_solve), counterMax is 0 if the settings can not be reached
+ */
+typedef struct
+{
+    uint8_t     prescaler;              // PWM_PRESCALER_NONE, PWM_PRESCALER_4, PWM_PRESCALER_32 or PWM_PRESCALER_256
+    uint8_t     sourceClock;            // PWM_SOURCE_CLK_PLL_64MHZ, PWM_SOURCE_CLK_PLL_32MHZ or PWM_SOURCE_CLK_CPU_CLK
+    uint8_t     deadTimeNbCycles;       // Dead time [PSC cycles]
+    uint16_t    counterMax;             // Counter maximum, also the duty-cycle maximum
+} m32m1_pwm_config;
+
+
+
+
+// ____________________________________________
+// ::: Frequency solver (compile time or runtime) :::
+// The options are sorted by decreasing PSC clock, so the first valid option gives the finest resolution
+// Center aligned mode : frequency = PSC clock / (2 x (counterMax + deadTimeNbCycles))
+
+
+/*!
+ * \brief pwm_optionSourceClock Source clock of a solver option (64MHz PLL, 32MHz PLL, CPU clock)
+ */
+constexpr uint8_t pwm_optionSourceClock(uint8_t option)
+{
+    return option%3==0 ? PWM_SOURCE_CLK_PLL_64MHZ : option%3==1 ? PWM_SOURCE_CLK_PLL_32MHZ : PWM_SOURCE_CLK_CPU_CLK;
+}
+
+
+/*!
+ * \brief pwm_optionPrescaler   Prescaler of a solver option (1, 4, 32, 256)
+ */
+constexpr uint8_t pwm_optionPrescaler(uint8_t option)
+{
+    return option/3==0 ? PWM_PRESCALER_NONE : option/3==1 ? PWM_PRESCALER_4 : option/3==2 ? PWM_PRESCALER_32 : PWM_PRESCALER_256;
+}
+
+
+/*!
+ * \brief pwm_optionClockHz     PSC clock of a solver option [Hz]
+ */
+constexpr uint32_t pwm_optionClockHz(uint8_t option)
+{
+    return (option%3==0 ? 64000000UL : option%3==1 ? 32000000UL : F_CPU)
+            / (option/3==0 ? 1 : option/3==1 ? 4 : option/3==2 ? 32 : 256);
+}
+
+
+/*!
+ * \brief pwm_deadTimeCycles    Dead time in PSC cycles, rounded up
+ *                              (all the PSC clocks are multiple of 500Hz, deadTimeNs must be lower than 30000)
+ */
+constexpr uint32_t pwm_deadTimeCycles(uint32_t clockHz, uint16_t deadTimeNs)
+{
+    return ((uint32_t)deadTimeNs*(clockHz/500) + 1999999UL)/2000000UL;
+}
+
+
+/*!
+ * \brief pwm_halfPeriodCycles  Half PWM period in PSC cycles, rounded to nearest
+ */
+constexpr uint32_t pwm_halfPeriodCycles(uint32_t clockHz, uint32_t frequencyHz)
+{
+    return (clockHz/2 + frequencyHz/2)/frequencyHz;
+}
+
+
+/*!
+ * \brief pwm_optionIsValid     true if the option reaches the frequency with at least PWM_COUNTER_MAX_MIN steps
+ */
+constexpr bool pwm_optionIsValid(uint8_t option, uint32_t frequencyHz, uint16_t deadTimeNs)
+{
+    return pwm_halfPeriodCycles(pwm_optionClockHz(option), frequencyHz)<=PWM_HALF_PERIOD_MAX_CYCLES
+        && pwm_deadTimeCycles(pwm_optionClockHz(option), deadTimeNs)<=0xFF
+        && pwm_halfPeriodCycles(pwm_optionClockHz(option), frequencyHz)
+           >= pwm_deadTimeCycles(pwm_optionClockHz(option), deadTimeNs)+PWM_COUNTER_MAX_MIN;
+}
+
+
+/*!
+ * \brief pwm_solveOption       First valid option from the given one, PWM_SOLVER_OPTIONS if none
+ */
+constexpr uint8_t pwm_solveOption(uint32_t frequencyHz, uint16_t deadTimeNs, uint8_t option=0)
+{
+    return option>=PWM_SOLVER_OPTIONS ? PWM_SOLVER_OPTIONS
+         : pwm_optionIsValid(option, frequencyHz, deadTimeNs) ? option
+         : pwm_solveOption(frequencyHz, deadTimeNs, option+1);
+}
+
+
+/*!
+ * \brief pwm_configFromOption  PSC settings of a solver option
+ */
+constexpr m32m1_pwm_config pwm_configFromOption(uint8_t option, uint32_t frequencyHz, uint16_t deadTimeNs)
+{
+    return option>=PWM_SOLVER_OPTIONS ? m32m1_pwm_config{PWM_PRESCALER_NONE, PWM_SOURCE_CLK_PLL_64MHZ, 0, 0}
+         : m32m1_pwm_config{pwm_optionPrescaler(option),
+                            pwm_optionSourceClock(option),
+                            (uint8_t)pwm_deadTimeCycles(pwm_optionClockHz(option), deadTimeNs),
+                            (uint16_t)(pwm_halfPeriodCycles(pwm_optionClockHz(option), frequencyHz)
+                                       - pwm_deadTimeCycles(pwm_optionClockHz(option), deadTimeNs))};
+}
+
+
+/*!
+ * \brief pwm_solve     Compute the PSC settings for a switching frequency and a dead time
+ *                      Constant arguments are solved at compile time (constexpr), or at runtime otherwise
+ *                      The finest resolution (highest PSC clock) is selected
+ * \param frequencyHz   Switching frequency [Hz]
+ * \param deadTimeNs    Dead time [ns], rounded up to the PSC clock (lower than 30000)
+ * \return              The PSC settings, counterMax is 0 if the frequency can not be reached
+ */
+constexpr m32m1_pwm_config pwm_solve(uint32_t frequencyHz, uint16_t deadTimeNs)
+{
+    return pwm_configFromOption(pwm_solveOption(frequencyHz, deadTimeNs), frequencyHz, deadTimeNs);
+}
+
+
+
+
 // When the function pwm_setOutputConfiguration is called with this parameter,
 // all the PWM are disable.
 #define         PWM_CONFIG_DISABLE_ALL          0b000000
@@ -50,6 +181,35 @@
 
 
 
+/*!
+ * \brief The m32m1_psc_channel struct  PSC channel driver with a fixed configuration (channel, dead time and
+ *                                      counter maximum are constants) : the duty-cycle update compiles to a
+ *                                      bound and two register stores with constant addresses
+ *                                      The PSC must be initialized with the same settings (m32m1_pwm::init)
+ *                                      e.g. m32m1_psc_channel<0, CONFIG.deadTimeNbCycles, CONFIG.counterMax>
+ */
+template<uint8_t Channel, uint8_t DeadTimeNbCycles, uint16_t CounterMax>
+struct m32m1_psc_channel
+{
+    static_assert(Channel<3, "The PSC has 3 channels");
+    static_assert(CounterMax+DeadTimeNbCycles<=PWM_HALF_PERIOD_MAX_CYCLES, "POCR_RB is 12 bits");
+
+    /*!
+     * \brief setDutyCycle  Set new duty-cycle, bounded to CounterMax
+     *                      If PSC is locked, the changes will be taken into
+     *                      account when the PSC will be unlocked
+     */
+    static inline void setDutyCycle(uint16_t dutyCycle)
+    {
+        if (dutyCycle>CounterMax) dutyCycle=CounterMax;
+        (&POCR0SA)[3*Channel]=dutyCycle;
+        (&POCR0SA)[3*Channel+2]=dutyCycle+DeadTimeNbCycles;
+    }
+};
+
+
+
+
 class m32m1_pwm
 {
 public:
@@ -87,6 +247,38 @@ public:
 		    uint16_t    counterMaximum=PWM_COUNTER_MAX_DEFAULT);
 
 
+    /*!
+     * \brief init                  Initialize PWM with solved settings (see pwm_solve)
+     * \param config                PSC settings, counterMax must not be 0
+     */
+    void    init   (const m32m1_pwm_config& config);
+
+
+    /*!
+     * \brief begin                 Non-blocking initialization : configure the PWM and start the source clock
+     *                              The outputs stay disabled and the PSC stopped until isStarted returns true
+     *                              Parameters are the same as init
+     */
+    void    begin  (uint8_t     prescaler,
+                    uint8_t     sourceClock,
+                    uint8_t     deadTimeNumberCycles,
+                    uint16_t    counterMaximum=PWM_COUNTER_MAX_DEFAULT);
+
+
+    /*!
+     * \brief begin                 Non-blocking initialization with solved settings (see pwm_solve)
+     */
+    void    begin  (const m32m1_pwm_config& config);
+
+
+    /*!
+     * \brief isStarted             Poll the non-blocking initialization, the PSC is started as soon as
+     *                              the source clock is ready (PLL locked)
+     * \return                      true if the PSC is running
+     */
+    bool    isStarted();
+
+
     /*!
      * \brief setPrescaler	    Set prescaler (select the PSC input clock division factor)
      * \param prescaler		    requested prescaler, possible values are:
@@ -98,16 +290,6 @@ public:
     void    setPrescaler(uint8_t prescaler);
 
 
-    /*!
-     * \brief setSourceClock	    Set the source clok for the PWM device
-     * \param sourceClock	    requested source clock, possible values are:
-     *				    PWM_SOURCE_CLK_CPU_CLK	=> select the slow clock input (CLKIO).
-     *				    PWM_SOURCE_CLK_PLL_32MHZ	=> select the fast clock input (CLKPLL) at 32MHz.
-     *				    PWM_SOURCE_CLK_PLL_64MHZ	=> select the fast clock input (CLKPLL) at 64MHz.
-     */
-    void	setSourceClock(uint8_t sourceClock);
-
-
     /*!
      * \brief setCounterMax	    Set the maximum value fo the PWM counter (output compare match)
      * \param counterMaximum	    Maximum value, this is also equal to the duty-cycle maximum
@@ -116,6 +298,13 @@ public:
     void	setCounterMax(uint16_t counterMaximum);
 
 
+    /*!
+     * \brief getCounterMax     Get the maximum value of the PWM counter (duty-cycle maximum)
+     * \return                  The counter maximum value
+     */
+    inline uint16_t getCounterMax() { return counterMax; }
+
+
     /*!
      * \brief setOutputConfiguration	Enable or disable each PWM channel
      * \param Config                    This variable is composed of 6 bits :
@@ -127,7 +316,8 @@ public:
 
 
     /*!
-     * \brief pwm_setDutyCycle0     Set new duty-cycle for PWM 0
+     * \brief setDutyCycle<Channel> Set new duty-cycle for a PWM channel known at compile time
+     *                              Inlined : the registers addresses are constant
      *                              If PSC is locked, the changes will be taken into
      *                              account when the PSC will be unlocked
      * \param dutyCycle             Duty-cycle value
@@ -135,31 +325,70 @@ public:
      *                              - Maximum value : PWM_COUNTER_MAX(100%)
      *				    dutyCcyle is automaticaly bounded if outside of range
      */
-    void	setDutyCycle0(uint16_t dutyCycle);
+    template<uint8_t Channel>
+    inline void setDutyCycle(uint16_t dutyCycle)
+    {
+        static_assert(Channel<3, "The PSC has 3 channels");
+        if (dutyCycle>counterMax) dutyCycle=counterMax;
+        // The compare registers of the channels are evenly spaced (POCRnSA, POCRnRA, POCRnSB)
+        (&POCR0SA)[3*Channel]=dutyCycle;
+        (&POCR0SA)[3*Channel+2]=dutyCycle+deadTimeNbCycles;
+    }
 
 
     /*!
-     * \brief pwm_setDutyCycle1     Set new duty-cycle for PWM 1
-     *                              If PSC is locked, the changes will be taken into
-     *                              account when the PSC will be unlocked
-     * \param dutyCycle             Duty-cycle value
-     *                              - Minimum value : 0(0%)
-     *                              - Maximum value : PWM_COUNTER_MAX(100%)
-     *				    dutyCcyle is automaticaly bounded if outside of range
+     * \brief pwm_setDutyCycle0     Set new duty-cycle for PWM 0 (see setDutyCycle<Channel>)
      */
-    void	setDutyCycle1(uint16_t dutyCycle);
+    inline void setDutyCycle0(uint16_t dutyCycle) { setDutyCycle<0>(dutyCycle); }
 
 
     /*!
-     * \brief pwm_setDutyCycle2     Set new duty-cycle for PWM 2
-     *                              If PSC is locked, the changes will be taken into
-     *                              account when the PSC will be unlocked
-     * \param dutyCycle             Duty-cycle value
+     * \brief pwm_setDutyCycle1     Set new duty-cycle for PWM 1 (see setDutyCycle<Channel>)
+     */
+    inline void setDutyCycle1(uint16_t dutyCycle) { setDutyCycle<1>(dutyCycle); }
+
+
+    /*!
+     * \brief pwm_setDutyCycle2     Set new duty-cycle for PWM 2 (see setDutyCycle<Channel>)
+     */
+    inline void setDutyCycle2(uint16_t dutyCycle) { setDutyCycle<2>(dutyCycle); }
+
+
+    /*!
+     * \brief setDutyCycle      Set new duty-cycle for the PWM channel given at runtime
+     *                          Dispatched to setDutyCycle<Channel> (folded if the channel is a constant)
+     *                          If PSC is locked, the changes will be taken into
+     *                          account when the PSC will be unlocked
+     * \param channel           PWM channel (0, 1 or 2)
+     * \param dutyCycle         Duty-cycle value
      *                              - Minimum value : 0(0%)
      *                              - Maximum value : PWM_COUNTER_MAX(100%)
      *				    dutyCcyle is automaticaly bounded if outside of range
      */
-    void	setDutyCycle2(uint16_t dutyCycle);
+    inline void setDutyCycle(uint8_t channel, uint16_t dutyCycle)
+    {
+        switch (channel)
+        {
+        case 0 : setDutyCycle<0>(dutyCycle); break;
+        case 1 : setDutyCycle<1>(dutyCycle); break;
+        case 2 : setDutyCycle<2>(dutyCycle); break;
+        }
+    }
+
+
+    /*!
+     * \brief setDutyCycles     Set the duty-cycles of the 3 channels
+     *                          Called between lock and unlock, all the changes are taken simultaneously
+     * \param dutyCycle0        Duty-cycle of PWM 0
+     * \param dutyCycle1        Duty-cycle of PWM 1
+     * \param dutyCycle2        Duty-cycle of PWM 2
+     */
+    inline void setDutyCycles(uint16_t dutyCycle0, uint16_t dutyCycle1, uint16_t dutyCycle2)
+    {
+        setDutyCycle<0>(dutyCycle0);
+        setDutyCycle<1>(dutyCycle1);
+        setDutyCycle<2>(dutyCycle2);
+    }
 
 
     /*!
@@ -192,8 +421,14 @@ private:
     // Internal PLL, can be used as source clock
     m32m1_pll		pll;
 
-    // Current dead-time
-    volatile uint8_t	deadTimeNbCycles;
+    // PSC running (started by isStarted)
+    bool		running;
+
+    // The source clock is the PLL (isStarted waits for the lock)
+    bool		pllSource;
+
+    // Current dead-time (only changed by init)
+    uint8_t		deadTimeNbCycles;
 
     // Current counter max (PSC Output Compare Register)
     uint16_t		counterMax;
@@ -0,0 +1,108 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <stdint.h>
+
+
+// Values shared between an interrupt and a lower priority context, without masking the interrupts
+// (the interrupts never nest, see the interrupt model in README.md) :
+//  - mailbox_seqlock : written by an interrupt, read by the main context (retry on concurrent write)
+//  - mailbox_double  : written by the main context, read by the interrupts (double buffer, index flip)
+// The copies are done by the compiler (any size), the memory barriers keep the accesses in order
+
+#define             MAILBOX_BARRIER()       __asm__ __volatile__ ("" ::: "memory")
+
+
+
+
+/*!
+ * \brief The mailbox_seqlock class Interrupt to main context handoff
+ *                                  The sequence counter changes after each write, the reader
+ *                                  retries until the counter is unchanged across its copy
+ */
+template<typename T>
+class mailbox_seqlock
+{
+public:
+
+    /*!
+     * \brief write     Publish a value (single writer : one interrupt, or a context with the interrupts disabled)
+     */
+    void write(const T& Value)
+    {
+        value=Value;
+        MAILBOX_BARRIER();
+        seq=seq+1;
+    }
+
+    /*!
+     * \brief last      Last published value, for the writer only (no retry)
+     */
+    const T& last() const
+    {
+        return value;
+    }
+
+    /*!
+     * \brief read      Copy of the last published value (any context, never interrupted by a
+     *                  write when called from an interrupt, so the loop runs once)
+     */
+    T read() const
+    {
+        uint8_t Seq;
+        T Copy;
+        do
+        {
+            Seq=seq;
+            MAILBOX_BARRIER();
+            Copy=value;
+            MAILBOX_BARRIER();
+        } while (Seq!=seq);
+        return Copy;
+    }
+
+private:
+    T                   value;
+    volatile uint8_t    seq;
+};
+
+
+
+
+/*!
+ * \brief The mailbox_double class  Main context to interrupt handoff
+ *                                  The writer fills the inactive buffer then flips the index (one byte,
+ *                                  atomic). The interrupts always copy a complete buffer
+ */
+template<typename T>
+class mailbox_double
+{
+public:
+
+    /*!
+     * \brief write     Publish a value (single writer : the main context)
+     */
+    void write(const T& Value)
+    {
+        uint8_t Next=active^1;
+        buffer[Next]=Value;
+        MAILBOX_BARRIER();
+        active=Next;
+    }
+
+    /*!
+     * \brief read      Copy of the last published value (interrupts, or the writer context)
+     */
+    T read() const
+    {
+        MAILBOX_BARRIER();
+        return buffer[active];
+    }
+
+private:
+    T                   buffer[2];
+    volatile uint8_t    active;
+};
+
+
+#endif // MAILBOX_H
@@ -21,5 +21,6 @@ void Output::setLow() {
 }
 
 void Output::toggle() {
-    *(pin) |= (1 << pinmask);
+    // Writing one to PINx toggles PORTx : a read-modify-write would toggle every high pin of the port
+    *(pin) = (1 << pinmask);
 }
@@ -0,0 +1,117 @@
+#include "profile.h"
+
+#if ENABLE_PROFILING
+
+#include <util/atomic.h>
+#include <string.h>
+
+
+
+
+// ________________________
+// ::: Global variables :::
+
+
+// Statistics of the handlers, updated by the interrupts
+profile_handler_t   profile_Handlers[PROFILE_NB_HANDLERS];
+
+// Idle time of the current window [timebase ticks], sleep start
+volatile uint16_t   profile_Idle;
+volatile bool       profile_Sleeping;
+uint16_t            profile_SleepStart;
+
+// Worst latency since the last summary frame
+volatile uint16_t   profile_LatencyMax;
+volatile uint8_t    profile_LatencyHandler;
+
+// Report state (main context) : start of the load window, peak load, next frame
+uint16_t            profile_WindowStart;
+uint16_t            profile_LoadPeak;
+uint8_t             profile_Next;
+
+
+
+
+// Reset the statistics of a handler (interrupts disabled)
+static void profile_resetHandler(uint8_t Id)
+{
+    profile_Handlers[Id].count=0;
+    profile_Handlers[Id].min=UINT16_MAX;
+    profile_Handlers[Id].max=0;
+    profile_Handlers[Id].sum=0;
+}
+
+
+
+
+// Reset the statistics
+void profile_init()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        for (uint8_t i=0; i<PROFILE_NB_HANDLERS; i++) profile_resetHandler(i);
+        profile_Idle=0;
+        profile_Sleeping=false;
+        profile_LatencyMax=0;
+        profile_LatencyHandler=0;
+        profile_WindowStart=TCNT1;
+    }
+    profile_LoadPeak=0;
+    profile_Next=PROFILE_SUMMARY;
+}
+
+
+// Close the load window, encode the next frame
+void profile_report(uint8_t* Buffer)
+{
+    // CPU load of the window : time not spent sleeping
+    uint16_t Now, Idle;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        Now=TCNT1;
+        Idle=profile_Idle;
+        profile_Idle=0;
+    }
+    uint16_t Window=Now-profile_WindowStart;
+    profile_WindowStart=Now;
+    uint16_t Load=(Window==0 || Idle>=Window) ? 0 : 1000-(uint16_t)(((uint32_t)Idle*1000)/Window);
+    if (Load>profile_LoadPeak) profile_LoadPeak=Load;
+
+    memset(Buffer, 0, PROFILE_DLC);
+    Buffer[0]=profile_Next;
+
+    if (profile_Next==PROFILE_SUMMARY)
+    {
+        uint16_t Latency;
+        uint8_t Handler;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            Latency=profile_LatencyMax;
+            Handler=profile_LatencyHandler;
+            profile_LatencyMax=0;
+        }
+        memcpy(&Buffer[1], &Load, sizeof(uint16_t));
+        memcpy(&Buffer[3], &profile_LoadPeak, sizeof(uint16_t));
+        memcpy(&Buffer[5], &Latency, sizeof(uint16_t));
+        Buffer[7]=Handler;
+        profile_LoadPeak=0;
+        profile_Next=0;
+    }
+    else
+    {
+        profile_handler_t Stats;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            Stats=profile_Handlers[profile_Next];
+            profile_resetHandler(profile_Next);
+        }
+        uint16_t Average=(Stats.count==0) ? 0 : (uint16_t)((Stats.sum<<4)/Stats.count);
+        memcpy(&Buffer[1], &Stats.count, sizeof(uint16_t));
+        Buffer[3]=(Stats.count==0) ? 0 : (Stats.min>0xFF ? 0xFF : (uint8_t)Stats.min);
+        memcpy(&Buffer[4], &Stats.max, sizeof(uint16_t));
+        memcpy(&Buffer[6], &Average, sizeof(uint16_t));
+        profile_Next = (profile_Next+1<PROFILE_NB_HANDLERS) ? profile_Next+1 : PROFILE_SUMMARY;
+    }
+}
+
+#endif // ENABLE_PROFILING
@@ -0,0 +1,156 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include "config.h"
+
+
+// Interrupt handlers (index of the statistics)
+#define             PROFILE_TICK            0       // TIMER1_COMPA, scheduler tick
+#define             PROFILE_COMMUTATION     1       // TIMER1_COMPB, phase advance / sensorless one-shot
+#define             PROFILE_SINE            2       // TIMER0_COMPA, sinusoidal drive refresh
+#define             PROFILE_CAN             3       // CAN_INT
+#define             PROFILE_HALL            4       // PCINT1/2, hall sensors
+#define             PROFILE_ADC             5       // ADC, current loop (conversion triggered by the PSC)
+#define             PROFILE_COMPARATOR      6       // ANACOMP0/1/2, back-EMF zero crossing
+#define             PROFILE_NB_HANDLERS     7
+
+// Diagnostics frame (8 bytes, little endian), one frame per report, the summary then each handler :
+//  summary : | 0xFF | CPU load, last window [1/1000] (uint16) | peak CPU load [1/1000] (uint16) |
+//            | worst latency [4us] (uint16) | handler of the worst latency (uint8) |
+//  handler : | index (uint8) | count (uint16) | min [4us] (uint8) | max [4us] (uint16) | average [1/16 x 4us] (uint16) |
+// The statistics of a frame cover the time since the previous frame of the same kind, then are reset
+#define             PROFILE_DLC             8
+#define             PROFILE_SUMMARY         0xFF
+
+// Overhead (ENABLE_PROFILING=1) : about 70 cycles per interrupt (4.5us at 16MHz, timestamps, idle time and
+// statistics update, estimated from the entry and exit code) and 85 bytes of RAM. The durations exclude
+// the registers saved by the interrupt prologue. With ENABLE_PROFILING=0 the macros are empty.
+
+
+
+
+#if ENABLE_PROFILING
+
+#include <avr/io.h>
+
+
+/*!
+ * \brief The profile_handler_t struct  Statistics of one interrupt handler [timebase ticks, 4us]
+ */
+typedef struct
+{
+    uint16_t    count;
+    uint16_t    min;
+    uint16_t    max;
+    uint32_t    sum;
+} profile_handler_t;
+
+extern profile_handler_t    profile_Handlers[PROFILE_NB_HANDLERS];
+extern volatile uint16_t    profile_Idle;
+extern volatile bool        profile_Sleeping;
+extern uint16_t             profile_SleepStart;
+extern volatile uint16_t    profile_LatencyMax;
+extern volatile uint8_t     profile_LatencyHandler;
+
+
+
+
+/*!
+ * \brief profile_enter     Timestamp of an interrupt entry, ends the idle time if the CPU was sleeping
+ */
+static inline uint16_t profile_enter()
+{
+    uint16_t Now=TCNT1;
+    if (profile_Sleeping)
+    {
+        profile_Idle+=Now-profile_SleepStart;
+        profile_Sleeping=false;
+    }
+    return Now;
+}
+
+
+/*!
+ * \brief profile_exit      Duration of an interrupt handler
+ */
+static inline void profile_exit(uint8_t Id, uint16_t Entry)
+{
+    uint16_t Duration=TCNT1-Entry;
+    profile_handler_t* Handler=&profile_Handlers[Id];
+    Handler->count++;
+    Handler->sum+=Duration;
+    if (Duration<Handler->min) Handler->min=Duration;
+    if (Duration>Handler->max) Handler->max=Duration;
+}
+
+
+/*!
+ * \brief profile_latency   Delay between the event and the interrupt entry
+ */
+static inline void profile_latency(uint8_t Id, uint16_t Latency)
+{
+    if (Latency<=profile_LatencyMax) return;
+    profile_LatencyMax=Latency;
+    profile_LatencyHandler=Id;
+}
+
+
+/*!
+ * \brief profile_sleep     Start of the idle time (interrupts disabled, just before sleeping)
+ */
+static inline void profile_sleep()
+{
+    profile_SleepStart=TCNT1;
+    profile_Sleeping=true;
+}
+
+
+/*!
+ * \brief The profile_scope class   Times an interrupt handler from its declaration to the return (all the paths)
+ */
+class profile_scope
+{
+public:
+    explicit profile_scope(uint8_t Id) : id(Id), entry(profile_enter()) {}
+    profile_scope(uint8_t Id, uint16_t EventTime) : id(Id), entry(profile_enter()) { profile_latency(Id, entry-EventTime); }
+    ~profile_scope() { profile_exit(id, entry); }
+
+private:
+    uint8_t     id;
+    uint16_t    entry;
+};
+
+
+// First statement of an interrupt service routine
+#define PROFILE_ISR(id)                     profile_scope profile_Scope(id)
+// Same, with the latency from the event time (e.g. the compare register of a timer interrupt)
+#define PROFILE_ISR_EVENT(id, eventTime)    profile_scope profile_Scope(id, eventTime)
+// Before sleeping (interrupts disabled)
+#define PROFILE_SLEEP()                     profile_sleep()
+
+
+/*!
+ * \brief profile_init      Reset the statistics and start the first load window
+ */
+void            profile_init();
+
+
+/*!
+ * \brief profile_report    Close the load window and encode the next diagnostics frame (main context)
+ *                          The window must be shorter than the timebase period (262ms)
+ * \param Buffer            Destination, PROFILE_DLC bytes
+ */
+void            profile_report(uint8_t* Buffer);
+
+
+#else
+
+#define PROFILE_ISR(id)
+#define PROFILE_ISR_EVENT(id, eventTime)
+#define PROFILE_SLEEP()
+
+#endif // ENABLE_PROFILING
+
+
+#endif // PROFILE_H
@@ -0,0 +1,159 @@
+#include "sched.h"
+#include "timebase.h"
+#include "profile.h"
+#include <avr/sleep.h>
+#include <util/atomic.h>
+#include <string.h>
+
+
+
+
+// ________________________
+// ::: Global variables :::
+
+
+// Task table, in priority order (bit i of the masks : task sched_Tasks[sched_Order[i]])
+const sched_task_t* sched_Tasks;
+uint8_t             sched_NbTasks;
+uint8_t             sched_Order[SCHED_MAX_TASKS];
+
+// Ticks before the next release of each task (priority order, tick interrupt only)
+uint16_t            sched_Countdown[SCHED_MAX_TASKS];
+
+// Released tasks not run yet (priority order), set by the tick interrupt, cleared by sched_run
+volatile uint8_t    sched_Pending;
+
+// Counters (table order)
+sched_stats_t       sched_Stats[SCHED_MAX_TASKS];
+
+
+
+
+// Reload the countdowns : every task is released at its phase from the next tick
+static void sched_restart()
+{
+    for (uint8_t i=0; i<sched_NbTasks; i++) sched_Countdown[i]=sched_Tasks[sched_Order[i]].phase+1;
+}
+
+
+
+
+// Register the task table
+bool sched_init(const sched_task_t* Tasks, uint8_t NbTasks)
+{
+    if (NbTasks>SCHED_MAX_TASKS) return false;
+    sched_Tasks=Tasks;
+    sched_NbTasks=NbTasks;
+    sched_Pending=0;
+    memset(sched_Stats, 0, sizeof(sched_Stats));
+
+    // Priority order (insertion sort, the table order is kept between equal priorities)
+    for (uint8_t i=0; i<NbTasks; i++)
+    {
+        uint8_t j=i;
+        while (j>0 && Tasks[sched_Order[j-1]].priority>Tasks[i].priority)
+        {
+            sched_Order[j]=sched_Order[j-1];
+            j--;
+        }
+        sched_Order[j]=i;
+    }
+    sched_restart();
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    return true;
+}
+
+
+// Start the tick
+void sched_start()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        OCR1A = TCNT1 + TIMEBASE_HZ_TO_TICKS(SCHED_TICK_HZ);
+        TIFR1 = (1<<OCF1A);                     // Clear a compare match which occured before
+        TIMSK1 |= (1<<OCIE1A);                  // Enable compare interrupt on A
+    }
+}
+
+
+// Realign the schedule on an external event
+void sched_realign(uint16_t Time)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        OCR1A = Time + TIMEBASE_HZ_TO_TICKS(SCHED_TICK_HZ);
+        TIFR1 = (1<<OCF1A);                     // A compare match already pending would give a short period
+
+        // Skip the ticks before the next release of the highest priority task : every countdown moves by the same
+        // number of ticks (modulo its period), the tasks keep their phase relative to this task and keep running
+        uint16_t Skip=sched_Countdown[0]-1;
+        for (uint8_t i=0; i<sched_NbTasks; i++)
+        {
+            uint16_t Period=sched_Tasks[sched_Order[i]].period;
+            uint16_t Left=(sched_Countdown[i]-1) % Period;
+            uint16_t Shift=Skip % Period;
+            sched_Countdown[i]=(Left>=Shift ? Left-Shift : Left+Period-Shift)+1;
+        }
+    }
+}
+
+
+// Run the released tasks, then sleep
+void sched_run()
+{
+    while (1)
+    {
+        // Highest priority released task
+        uint8_t Pending=sched_Pending;
+        if (Pending==0) break;
+        uint8_t i=0;
+        while (!(Pending & (1<<i))) i++;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { sched_Pending &= ~(1<<i); }
+
+        uint8_t Index=sched_Order[i];
+        uint16_t Start=timebase_now();
+        sched_Tasks[Index].task();
+        uint16_t Duration=timebase_now()-Start;
+        if (Duration>sched_Stats[Index].wcet) sched_Stats[Index].wcet=Duration;
+    }
+
+    // Idle until the next interrupt (the flag is tested with the interrupts disabled, sei is followed by sleep)
+    cli();
+    if (sched_Pending==0)
+    {
+        PROFILE_SLEEP();
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+    }
+    sei();
+}
+
+
+// Copy of the counters
+void sched_getStats(uint8_t Index, sched_stats_t* Stats)
+{
+    if (Index>=sched_NbTasks) return;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { *Stats=sched_Stats[Index]; }
+}
+
+
+
+
+// Tick : release the tasks
+ISR(TIMER1_COMPA_vect)
+{
+    PROFILE_ISR_EVENT(PROFILE_TICK, OCR1A);
+    OCR1A += TIMEBASE_HZ_TO_TICKS(SCHED_TICK_HZ);
+
+    for (uint8_t i=0; i<sched_NbTasks; i++)
+    {
+        if (--sched_Countdown[i]!=0) continue;
+        const sched_task_t* Task=&sched_Tasks[sched_Order[i]];
+        sched_Countdown[i]=Task->period;
+        if (sched_Pending & (1<<i)) sched_Stats[sched_Order[i]].overruns++;
+        sched_Pending |= (1<<i);
+    }
+}
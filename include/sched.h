@@ -0,0 +1,98 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+
+
+// Scheduler tick (Timer1 compare A, moved forward by one period at each interrupt)
+#define             SCHED_TICK_HZ           1000
+
+// Maximum number of tasks
+#define             SCHED_MAX_TASKS         8
+
+// Convert a rate into scheduler ticks
+#define             SCHED_HZ_TO_TICKS(hz)   ((uint16_t)(SCHED_TICK_HZ/(hz)))
+
+
+
+
+/*!
+ * \brief sched_task_fn_t   Task body, runs to completion in the main context (interrupts enabled)
+ */
+typedef void (*sched_task_fn_t)();
+
+
+/*!
+ * \brief The sched_task_t struct   One entry of the static task table
+ */
+typedef struct
+{
+    sched_task_fn_t task;               // Task body
+    uint16_t        period;             // Release period [ticks], 1 or more
+    uint16_t        phase;              // First release [ticks] after sched_start, lower than the period
+    uint8_t         priority;           // 0 is the highest, runs first when several tasks are released
+} sched_task_t;
+
+
+/*!
+ * \brief The sched_stats_t struct  Counters of one task
+ */
+typedef struct
+{
+    uint16_t        wcet;               // Longest execution [timebase ticks, 4us], interrupts included
+    uint16_t        overruns;           // Releases lost because the previous one had not run yet (wraps around)
+} sched_stats_t;
+
+
+
+
+/*!
+ * \brief sched_init    Register the task table (at init, interrupts disabled)
+ *                      The table is not copied and must stay valid
+ * \param Tasks         Task table
+ * \param NbTasks       Number of tasks, at most SCHED_MAX_TASKS
+ * \return              false if the table is too large
+ */
+bool            sched_init(const sched_task_t* Tasks, uint8_t NbTasks);
+
+
+/*!
+ * \brief sched_start   Start the tick (the timebase must be running), the first tick is one period later
+ */
+void            sched_start();
+
+
+/*!
+ * \brief sched_realign Realign the schedule on an external event (e.g. CAN SYNC), any context
+ *                      The next tick is one tick period after Time and the highest priority task is released
+ *                      by this tick. The other tasks keep their phase relative to it (the countdowns are not
+ *                      restarted : a task whose phase is longer than the event period still runs)
+ * \param Time          Timestamp of the event [timebase ticks]
+ */
+void            sched_realign(uint16_t Time);
+
+
+/*!
+ * \brief sched_run     Run the released tasks by priority, then sleep (idle mode) until the next interrupt
+ *                      Must be called in a loop by the main context
+ */
+void            sched_run();
+
+
+/*!
+ * \brief sched_getStats    Copy of the counters of a task
+ * \param Index             Index of the task in the table given to sched_init
+ * \param Stats             Destination
+ */
+void            sched_getStats(uint8_t Index, sched_stats_t* Stats);
+
+
+/*!
+ * \brief ISR(TIMER1_COMPA_vect)    Scheduler tick : releases the tasks
+ */
+ISR(TIMER1_COMPA_vect);
+
+
+#endif // SCHED_H
@@ -0,0 +1,32 @@
+#include "sine.h"
+#include <avr/pgmspace.h>
+
+
+// First quarter of the sine wave, sin(i*90/64 degrees) in Q1.15
+const int16_t sine_Table[65] PROGMEM =
+{
+        0,   804,  1608,  2411,  3212,  4011,  4808,  5602,
+     6393,  7180,  7962,  8740,  9512, 10279, 11039, 11793,
+    12540, 13279, 14010, 14733, 15447, 16151, 16846, 17531,
+    18205, 18868, 19520, 20160, 20788, 21403, 22006, 22595,
+    23170, 23732, 24279, 24812, 25330, 25833, 26320, 26791,
+    27246, 27684, 28106, 28511, 28899, 29269, 29622, 29957,
+    30274, 30572, 30853, 31114, 31357, 31581, 31786, 31972,
+    32138, 32286, 32413, 32522, 32610, 32679, 32729, 32758,
+    32767
+};
+
+
+// Sine of an angle (65536 = 360 degrees)
+int16_t sine_q15(uint16_t angle)
+{
+    // 256 points per turn, 64 per quarter
+    uint8_t Index=angle>>8;
+    uint8_t Quarter=Index>>6;
+    uint8_t Point=Index & 0x3F;
+
+    // Second and fourth quarters are mirrored, third and fourth are negative
+    if (Quarter & 0x01) Point=64-Point;
+    int16_t Value=pgm_read_word(&sine_Table[Point]);
+    return (Quarter & 0x02) ? -Value : Value;
+}
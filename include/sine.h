@@ -0,0 +1,36 @@
+#ifndef SINE_H
+#define SINE_H
+
+#include <stdint.h>
+
+
+// Angles are coded on 16 bits : 65536 = 360 degrees (the value wraps around with the angle)
+#define             SINE_ANGLE_30           5461
+#define             SINE_ANGLE_60           10923
+#define             SINE_ANGLE_90           16384
+#define             SINE_ANGLE_120          21845
+#define             SINE_ANGLE_240          43691
+
+
+
+
+/*!
+ * \brief sine_q15  Sine of an angle, read from a quarter wave table in flash (256 points per turn)
+ * \param angle     angle (65536 = 360 degrees)
+ * \return          sin(angle) in Q1.15 [-32767, 32767]
+ */
+int16_t sine_q15(uint16_t angle);
+
+
+/*!
+ * \brief cosine_q15    Cosine of an angle (see sine_q15)
+ * \param angle         angle (65536 = 360 degrees)
+ * \return              cos(angle) in Q1.15 [-32767, 32767]
+ */
+static inline int16_t cosine_q15(uint16_t angle)
+{
+    return sine_q15(angle+SINE_ANGLE_90);
+}
+
+
+#endif // SINE_H
@@ -0,0 +1,144 @@
+#include "speedctrl.h"
+
+
+
+
+// ________________________
+// ::: Global variables :::
+
+
+// Controller gains (Q6.10)
+int16_t speedctrl_Kp;
+int16_t speedctrl_Ki;
+int16_t speedctrl_Kaw;
+
+// Integral term [PWM] (Q16.16)
+q16_t speedctrl_Integral;
+
+// Output saturation flag
+bool speedctrl_Saturated;
+
+// Output and integral term bounds [PWM] (Q16.16)
+q16_t speedctrl_OutputMax=(q16_t)SPEEDCTRL_OUTPUT_MAX<<Q16_FRAC_BITS;
+q16_t speedctrl_IntegralMax=(q16_t)SPEEDCTRL_INTEGRAL_MAX<<Q16_FRAC_BITS;
+
+
+
+
+// _______________________
+// ::: Initializations :::
+
+
+// Initialize the controller
+void speedctrl_init(int16_t kp, int16_t ki, int16_t kaw)
+{
+    speedctrl_setGains(kp, ki, kaw);
+    speedctrl_reset();
+}
+
+
+// Reset the integral term
+void speedctrl_reset()
+{
+    speedctrl_Integral=0;
+    speedctrl_Saturated=false;
+}
+
+
+
+
+// ___________________________
+// ::: Getters and setters :::
+
+
+// Gain bounded to [0,Max]
+static inline int16_t speedctrl_boundGain(int16_t gain, int16_t Max)
+{
+    if (gain<0) return 0;
+    if (gain>Max) return Max;
+    return gain;
+}
+
+
+// Update all the gains
+void speedctrl_setGains(int16_t kp, int16_t ki, int16_t kaw)
+{
+    speedctrl_setKp(kp);
+    speedctrl_setKi(ki);
+    speedctrl_setKaw(kaw);
+}
+
+void speedctrl_setKp(int16_t kp)
+{
+    speedctrl_Kp=speedctrl_boundGain(kp, SPEEDCTRL_GAIN_MAX);
+}
+
+void speedctrl_setKi(int16_t ki)
+{
+    speedctrl_Ki=speedctrl_boundGain(ki, SPEEDCTRL_GAIN_MAX);
+}
+
+void speedctrl_setKaw(int16_t kaw)
+{
+    speedctrl_Kaw=speedctrl_boundGain(kaw, SPEEDCTRL_KAW_MAX);
+}
+
+
+// Output bound applied downstream
+void speedctrl_setOutputMax(int16_t outputMax)
+{
+    if (outputMax<0) outputMax=0;
+    speedctrl_OutputMax=(q16_t)outputMax<<Q16_FRAC_BITS;
+    speedctrl_IntegralMax=(outputMax<SPEEDCTRL_INTEGRAL_MAX ? (q16_t)outputMax : (q16_t)SPEEDCTRL_INTEGRAL_MAX)<<Q16_FRAC_BITS;
+}
+
+// Gains
+int16_t speedctrl_getKp()
+{
+    return speedctrl_Kp;
+}
+
+int16_t speedctrl_getKi()
+{
+    return speedctrl_Ki;
+}
+
+int16_t speedctrl_getKaw()
+{
+    return speedctrl_Kaw;
+}
+
+
+// Return true if the last output was bounded
+bool speedctrl_isSaturated()
+{
+    return speedctrl_Saturated;
+}
+
+
+
+
+// __________________
+// ::: Controller :::
+
+
+// Feedforward + PI with back-calculation anti-windup
+int16_t speedctrl_update(q16_t feedforward, q16_t error)
+{
+    // The error is bounded so that the products fit in 32 bits (see q16_mulQ10)
+    error=q16_clamp(error, Q16_FROM_CONST(256));
+
+    // Unbounded command
+    q16_t command = feedforward + q16_mulQ10(error, speedctrl_Kp) + speedctrl_Integral;
+
+    // Bounded command
+    q16_t bounded = q16_clamp(command, speedctrl_OutputMax);
+    speedctrl_Saturated=(bounded!=command);
+
+    // Integrate the error, minus the part of the command that can not be applied (back-calculation)
+    q16_t excess = q16_clamp(bounded-command, Q16_FROM_CONST(4096));
+    speedctrl_Integral = q16_clamp(speedctrl_Integral + q16_mulQ10(error, speedctrl_Ki) + q16_mulQ10(excess, speedctrl_Kaw),
+                                   speedctrl_IntegralMax);
+
+    return q16_toInt(bounded);
+}
@@ -0,0 +1,125 @@
+#ifndef SPEEDCTRL_H
+#define SPEEDCTRL_H
+
+#include <stdint.h>
+#include "fixed.h"
+#include "bldc.h"
+
+
+// Default output bound of the controller, same as the bound applied by bldc_setSpeed (see speedctrl_setOutputMax)
+#define             SPEEDCTRL_OUTPUT_MAX        BLDC_DUTY_MAX
+
+// Bound of the integral term (PWM units)
+#define             SPEEDCTRL_INTEGRAL_MAX      BLDC_DUTY_MAX
+
+// Safe gain ranges (Q6.10) : the products of speedctrl_update must stay below 8192 (see q16_mulQ10)
+// kp and ki multiply the error bounded to 256 rad.s-1 : any gain up to 31.99 (the int16 range)
+// kaw multiplies the saturation excess bounded to 4096 : below 2.0
+#define             SPEEDCTRL_GAIN_MAX          INT16_MAX
+#define             SPEEDCTRL_KAW_MAX           2047
+
+
+
+
+// _______________________
+// ::: Initializations :::
+
+
+/*!
+ * \brief speedctrl_init    Initialize the speed controller (feedforward + PI)
+ *                          The integral term is reset
+ * \param kp                Proportional gain  [PWM.s.rad-1]       Q6.10, 0 to SPEEDCTRL_GAIN_MAX
+ * \param ki                Integral gain per control period [PWM.rad-1]  Q6.10, 0 to SPEEDCTRL_GAIN_MAX
+ *                          (integral gain [PWM.rad-1.s-1] divided by the control frequency)
+ * \param kaw               Back-calculation anti-windup gain [0,1]  Q6.10, 0 to SPEEDCTRL_KAW_MAX
+ */
+void            speedctrl_init(int16_t kp, int16_t ki, int16_t kaw);
+
+
+/*!
+ * \brief speedctrl_reset   Reset the integral term
+ */
+void            speedctrl_reset();
+
+
+
+
+// ___________________________
+// ::: Getters and setters :::
+
+
+/*!
+ * \brief speedctrl_setGains    Update the controller gains (can be called at runtime)
+ *                              see speedctrl_init for units, the gains are bounded to their safe range
+ */
+void            speedctrl_setGains(int16_t kp, int16_t ki, int16_t kaw);
+
+/*!
+ * \brief speedctrl_setKp   Update the proportional gain (Q6.10, bounded to 0..SPEEDCTRL_GAIN_MAX)
+ */
+void            speedctrl_setKp(int16_t kp);
+
+/*!
+ * \brief speedctrl_setKi   Update the integral gain per control period (Q6.10, bounded to 0..SPEEDCTRL_GAIN_MAX)
+ */
+void            speedctrl_setKi(int16_t ki);
+
+/*!
+ * \brief speedctrl_setKaw  Update the anti-windup gain (Q6.10, bounded to 0..SPEEDCTRL_KAW_MAX)
+ */
+void            speedctrl_setKaw(int16_t kaw);
+
+/*!
+ * \brief speedctrl_setOutputMax    Set the output bound, when the command is bounded again downstream
+ *                                  (e.g. the current limit of the inner current loop) : the saturation and
+ *                                  the anti-windup must act on the bound which is really applied
+ *                                  The integral term is bounded to the lowest of the bound and SPEEDCTRL_INTEGRAL_MAX
+ * \param outputMax                 Output bound (positive), SPEEDCTRL_OUTPUT_MAX by default
+ */
+void            speedctrl_setOutputMax(int16_t outputMax);
+
+/*!
+ * \brief speedctrl_getKp   getter on the proportional gain (Q6.10)
+ */
+int16_t         speedctrl_getKp();
+
+/*!
+ * \brief speedctrl_getKi   getter on the integral gain per control period (Q6.10)
+ */
+int16_t         speedctrl_getKi();
+
+/*!
+ * \brief speedctrl_getKaw  getter on the anti-windup gain (Q6.10)
+ */
+int16_t         speedctrl_getKaw();
+
+
+/*!
+ * \brief speedctrl_isSaturated getter on the output saturation
+ * \return                      true if the last output was bounded
+ */
+bool            speedctrl_isSaturated();
+
+
+
+
+// __________________
+// ::: Controller :::
+
+
+/*!
+ * \brief speedctrl_update  Compute the PWM command, must be called once per control period
+ *                          u = feedforward + kp*error + integral, bounded to the output bound
+ *                          (SPEEDCTRL_OUTPUT_MAX or speedctrl_setOutputMax)
+ *                          The integral term is bounded to +/-SPEEDCTRL_INTEGRAL_MAX (or the lower output bound)
+ *                          and is corrected with kaw*(bounded u - u) when the output saturates
+ * \param feedforward       Feedforward command [PWM] Q16.16
+ * \param error             Speed error (command - measure) [rad.s-1] Q16.16
+ * \return                  The command in [-output bound, output bound]
+ */
+int16_t         speedctrl_update(q16_t feedforward, q16_t error);
+
+
+
+
+#endif // SPEEDCTRL_H
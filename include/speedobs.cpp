@@ -0,0 +1,89 @@
+#include "speedobs.h"
+#include "hall.h"
+#include "timebase.h"
+#include "mailbox.h"
+
+
+
+
+// ________________________
+// ::: Global variables :::
+
+
+// Angle between two edges x timebase frequency (Q16.16)
+uint32_t speedobs_EdgeGain;
+
+// Edge counter and timestamp of the last edge at the previous update
+uint8_t speedobs_previousCount;
+uint16_t speedobs_previousTime;
+
+// Number of updates without edge
+uint8_t speedobs_idleUpdates;
+
+// Last speed estimate, written by speedobs_update and read by the interrupts (SYNC)
+mailbox_double<q16_t> speedobs_Speed;
+
+
+
+
+// Initialize the observer
+void speedobs_init(q16_t edgeGain)
+{
+    uint16_t period;
+    speedobs_EdgeGain=edgeGain;
+    hall_getEdges(&speedobs_previousCount, &speedobs_previousTime, &period);
+    speedobs_idleUpdates=SPEEDOBS_TIMEOUT_UPDATES;
+    speedobs_Speed.write(0);
+}
+
+
+// Return the last estimate
+q16_t speedobs_getSpeed()
+{
+    return speedobs_Speed.read();
+}
+
+
+// Update the estimate from the hall edges
+q16_t speedobs_update()
+{
+    uint8_t count;
+    uint16_t time, period;
+    hall_getEdges(&count, &time, &period);
+
+    uint8_t edges=count-speedobs_previousCount;
+    uint32_t speed;
+
+    if (edges==0)
+    {
+        // No edge : the speed is at most one edge over the time elapsed since the last one
+        if (speedobs_idleUpdates<SPEEDOBS_TIMEOUT_UPDATES) speedobs_idleUpdates++;
+        uint16_t elapsed=timebase_now()-time;
+        if (speedobs_idleUpdates>=SPEEDOBS_TIMEOUT_UPDATES || period==0) speed=0;
+        else speed=speedobs_EdgeGain/(elapsed>period ? elapsed : period);
+    }
+    else if (speedobs_idleUpdates>=SPEEDOBS_TIMEOUT_UPDATES && edges==1)
+    {
+        // First edge after a stop, the period is unknown
+        speed=0;
+    }
+    else if (edges>=SPEEDOBS_M_METHOD_EDGES && speedobs_idleUpdates==0)
+    {
+        // M-method : count the edges between the last edges of two successive updates
+        speed=(speedobs_EdgeGain/(uint16_t)(time-speedobs_previousTime))*edges;
+    }
+    else
+    {
+        // T-method : period between the two last edges
+        speed=(period==0) ? 0 : speedobs_EdgeGain/period;
+    }
+    if (edges!=0) speedobs_idleUpdates=0;
+
+    speedobs_previousCount=count;
+    speedobs_previousTime=time;
+
+    // Sign according to the direction of rotation (the position increases when CCW)
+    q16_t Speed = (hall_getDirection()==HALL_DIRECTION_CCW) ? (q16_t)speed : -(q16_t)speed;
+    speedobs_Speed.write(Speed);
+    return Speed;
+}
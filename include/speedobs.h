@@ -0,0 +1,47 @@
+#ifndef SPEEDOBS_H
+#define SPEEDOBS_H
+
+#include <stdint.h>
+#include "fixed.h"
+
+
+// Number of edges in one update period above which the edge counting (M-method) is used
+// Below, the speed is given by the period between the two last edges (T-method)
+#define             SPEEDOBS_M_METHOD_EDGES     3
+
+// Number of update periods without edge after which the speed is considered null
+// Must be shorter than the timebase wrap around (262ms)
+#define             SPEEDOBS_TIMEOUT_UPDATES    20
+
+
+
+
+/*!
+ * \brief speedobs_init     Initialize the hall speed observer
+ * \param edgeGain          Angle between two hall edges multiplied by the timebase frequency
+ *                          [rad.s-1 x timebase ticks] Q16.16 (2PI/ticks per round*TIMEBASE_HZ)
+ */
+void            speedobs_init(q16_t edgeGain);
+
+
+/*!
+ * \brief speedobs_update   Update the speed estimate, must be called periodically (control period) by a single context
+ *                          - no edge since the last update : the speed decays as the time since the last edge
+ *                            increases, and is null after SPEEDOBS_TIMEOUT_UPDATES updates
+ *                          - less than SPEEDOBS_M_METHOD_EDGES edges : the period between the last two
+ *                            edges is used (T-method, 4us resolution)
+ *                          - otherwise : the number of edges is divided by the time between the last edge
+ *                            of this update and the last edge of the previous update (M-method)
+ * \return                  The speed [rad.s-1] Q16.16, positive when the position increases
+ */
+q16_t           speedobs_update();
+
+
+/*!
+ * \brief speedobs_getSpeed getter on the last speed estimate (can be called by an interrupt)
+ * \return                  The speed [rad.s-1] Q16.16
+ */
+q16_t           speedobs_getSpeed();
+
+
+#endif // SPEEDOBS_H
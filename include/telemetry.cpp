@@ -0,0 +1,78 @@
+#include "telemetry.h"
+
+
+
+
+// ________________________
+// ::: Global variables :::
+
+
+// Rate of telemetry_tick calls [Hz]
+uint16_t            telemetry_TickHz;
+
+// Ticks between two frames (0 : disabled) and ticks since the last frame
+uint16_t            telemetry_Divider;
+uint16_t            telemetry_Count;
+
+
+
+
+// Initialize the rate
+void telemetry_init(uint16_t TickHz, uint16_t RateHz)
+{
+    telemetry_TickHz=TickHz;
+    telemetry_setRate(RateHz);
+}
+
+
+// Change the rate
+void telemetry_setRate(uint16_t RateHz)
+{
+    if (RateHz>telemetry_TickHz) RateHz=telemetry_TickHz;
+    telemetry_Divider = (RateHz==0) ? 0 : telemetry_TickHz/RateHz;
+    telemetry_Count=0;
+}
+
+
+// Actual rate
+uint16_t telemetry_getRate()
+{
+    return (telemetry_Divider==0) ? 0 : telemetry_TickHz/telemetry_Divider;
+}
+
+
+// Count the ticks
+bool telemetry_tick()
+{
+    if (telemetry_Divider==0) return false;
+    if (++telemetry_Count<telemetry_Divider) return false;
+    telemetry_Count=0;
+    return true;
+}
+
+
+// Q16.16 to Q10.6, saturated
+int16_t telemetry_speed(q16_t Speed)
+{
+    int32_t SpeedQ6=Speed>>(Q16_FRAC_BITS-TELEMETRY_SPEED_FRAC_BITS);
+    if (SpeedQ6>INT16_MAX) SpeedQ6=INT16_MAX;
+    if (SpeedQ6<INT16_MIN) SpeedQ6=INT16_MIN;
+    return SpeedQ6;
+}
+
+
+// Encode the frame
+void telemetry_pack(uint8_t* Buffer, q16_t Speed, int32_t Position, int16_t Voltage,
+                    uint8_t Status, uint16_t ControlTime)
+{
+    int16_t SpeedQ6=telemetry_speed(Speed);
+
+    Buffer[0]=(uint8_t)SpeedQ6;
+    Buffer[1]=(uint8_t)(SpeedQ6>>8);
+    Buffer[2]=(uint8_t)Position;
+    Buffer[3]=(uint8_t)(Position>>8);
+    Buffer[4]=(uint8_t)Voltage;
+    Buffer[5]=(uint8_t)(Voltage>>8);
+    Buffer[6]=Status;
+    Buffer[7]=(ControlTime>0xFF) ? 0xFF : (uint8_t)ControlTime;
+}
@@ -0,0 +1,78 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "fixed.h"
+
+
+// Telemetry frame (8 bytes, little endian) :
+// | speed (int16) | position (uint16) | voltage command (int16) | status (uint8) | control time (uint8) |
+#define             TELEMETRY_DLC               8
+
+// Speed resolution : 1/64 rad.s-1 (Q10.6, range +-512 rad.s-1)
+#define             TELEMETRY_SPEED_FRAC_BITS   6
+
+// Status bits
+#define             TELEMETRY_STATUS_READY      0x01    // PWM running, the motor is commanded
+#define             TELEMETRY_STATUS_HALL_ERROR 0x02    // Invalid hall sequence detected since the last frame
+#define             TELEMETRY_STATUS_SINE       0x04    // Sinusoidal drive (six-step otherwise)
+#define             TELEMETRY_STATUS_ADVANCE    0x08    // Phase advance enabled
+#define             TELEMETRY_STATUS_SENSORLESS 0x10    // Back-EMF commutation active
+#define             TELEMETRY_STATUS_SATURATED  0x20    // Speed controller output bounded
+#define             TELEMETRY_STATUS_CAN_TX     0x40    // CAN frames dropped since the last frame (transmit queue full)
+#define             TELEMETRY_STATUS_CAN_RX     0x80    // CAN frames lost since the last frame (receive ring full)
+
+
+
+
+/*!
+ * \brief telemetry_init    Initialize the telemetry rate
+ * \param TickHz            Rate of telemetry_tick calls (control rate) [Hz]
+ * \param RateHz            Publish rate [Hz], 0 to disable
+ */
+void            telemetry_init(uint16_t TickHz, uint16_t RateHz);
+
+
+/*!
+ * \brief telemetry_setRate Change the publish rate, rounded to an integer divider of the tick rate
+ * \param RateHz            Publish rate [Hz], 0 to disable, bounded to the tick rate
+ */
+void            telemetry_setRate(uint16_t RateHz);
+
+
+/*!
+ * \brief telemetry_getRate Getter on the publish rate
+ * \return                  Actual publish rate [Hz] (tick rate / divider), 0 if disabled
+ */
+uint16_t        telemetry_getRate();
+
+
+/*!
+ * \brief telemetry_tick    Count the ticks, must be called once per control period
+ * \return                  true when a frame must be published
+ */
+bool            telemetry_tick();
+
+
+/*!
+ * \brief telemetry_speed   Convert a speed to the frame resolution
+ * \param Speed             Motor speed [rad.s-1] Q16.16
+ * \return                  Speed [1/64 rad.s-1] (Q10.6), saturated to the int16 range
+ */
+int16_t         telemetry_speed(q16_t Speed);
+
+
+/*!
+ * \brief telemetry_pack    Encode the telemetry frame
+ * \param Buffer            Destination, TELEMETRY_DLC bytes
+ * \param Speed             Motor speed [rad.s-1] Q16.16, saturated to the frame range
+ * \param Position          Hall position [ticks], the 16 low bits are sent
+ * \param Voltage           Voltage command [PWM]
+ * \param Status            Status bits (TELEMETRY_STATUS_...)
+ * \param ControlTime       Longest control task since the last frame [timebase ticks, 4us], saturated to 255
+ */
+void            telemetry_pack(uint8_t* Buffer, q16_t Speed, int32_t Position, int16_t Voltage,
+                               uint8_t Status, uint16_t ControlTime);
+
+
+#endif // TELEMETRY_H
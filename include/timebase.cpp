@@ -0,0 +1,10 @@
+#include "timebase.h"
+
+
+// Start the free-running counter
+void timebase_init()
+{
+    TCCR1A = 0x00;                          // Normal mode (no output compare pins)
+    TCCR1B = (1<<CS11)|(1<<CS10);           // Normal mode and prescaler set to 64 : 250kHz
+    TCNT1  = 0;
+}
@@ -0,0 +1,46 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <stdint.h>
+
+
+// Timer1 is a free-running counter clocked at F_CPU/64 (4us resolution, wraps every 262ms)
+// The compare units (OCR1A, OCR1B) are used to schedule periodic interrupts by
+// adding the period to the compare register in the interrupt service routine
+#define             TIMEBASE_PRESCALER      64
+#define             TIMEBASE_HZ             (F_CPU/TIMEBASE_PRESCALER)
+
+// Convert a duration into timebase ticks
+#define             TIMEBASE_US_TO_TICKS(us)    ((uint16_t)((us)*(TIMEBASE_HZ/1000)/1000))
+#define             TIMEBASE_HZ_TO_TICKS(hz)    ((uint16_t)(TIMEBASE_HZ/(hz)))
+
+
+
+
+/*!
+ * \brief timebase_init     Start Timer1 as a free-running counter (normal mode, prescaler 64)
+ *                          The compare interrupts are not enabled
+ */
+void timebase_init();
+
+
+/*!
+ * \brief timebase_now      Current value of the free-running counter
+ *                          The 16 bits read is protected against the interrupts which
+ *                          also access the Timer1 16 bits registers (shared TEMP register)
+ * \return                  The current timestamp (4us resolution)
+ */
+static inline uint16_t timebase_now()
+{
+    uint16_t now;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        now=TCNT1;
+    }
+    return now;
+}
+
+
+#endif // TIMEBASE_H
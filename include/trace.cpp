@@ -0,0 +1,204 @@
+#include "trace.h"
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <string.h>
+
+
+
+
+// ________________________
+// ::: Global variables :::
+
+
+// Circular buffer, trace_Head is the next record written, trace_Count the records kept (at most TRACE_SIZE)
+// Written by the control task (interrupts disabled) and the hall interrupt, read by trace_dump once frozen
+uint8_t             trace_Buffer[TRACE_SIZE][TRACE_RECORD_SIZE];
+uint8_t             trace_Edges[(TRACE_SIZE+7)/8];      // Hall edge records (one bit per record)
+uint8_t             trace_Head;
+uint8_t             trace_Count;
+
+// State, armed trigger sources and hall edges option
+volatile uint8_t    trace_State;
+uint8_t             trace_Triggers;
+volatile bool       trace_EdgesEnabled;
+
+// Records after the trigger : configured, applied by trace_arm, remaining
+uint8_t             trace_Post;
+uint8_t             trace_PostArmed;
+uint8_t             trace_Remaining;
+
+// Trigger cause and time
+uint8_t             trace_Cause;
+uint16_t            trace_TriggerTime;
+
+// Position of the previous control tick
+int32_t             trace_LastPosition;
+bool                trace_FirstTick;
+
+// Next dump frame : 0 header, then record 1 to trace_Count
+uint8_t             trace_DumpNext;
+
+
+
+
+// Stop recording, the buffer is dumped
+static void trace_freeze()
+{
+    trace_State=TRACE_FROZEN;
+    trace_EdgesEnabled=false;
+    trace_DumpNext=0;
+}
+
+
+// Trigger (interrupts disabled) : the last record written is the trigger record
+static void trace_fire(uint8_t Cause)
+{
+    if (trace_State!=TRACE_ARMED) return;
+    trace_Cause=Cause;
+    trace_TriggerTime=TCNT1;
+    trace_Remaining=trace_PostArmed;
+    if (trace_Remaining==0) trace_freeze();
+    else trace_State=TRACE_TRIGGERED;
+}
+
+
+// Write a record (interrupts disabled)
+static void trace_write(const uint8_t* Record, bool Edge)
+{
+    uint8_t State=trace_State;
+    if (State!=TRACE_ARMED && State!=TRACE_TRIGGERED) return;
+
+    uint8_t Head=trace_Head;
+    memcpy(trace_Buffer[Head], Record, TRACE_RECORD_SIZE);
+    if (Edge) trace_Edges[Head>>3] |= (1<<(Head & 7));
+    else trace_Edges[Head>>3] &= ~(1<<(Head & 7));
+    trace_Head=(Head+1<TRACE_SIZE) ? Head+1 : 0;
+    if (trace_Count<TRACE_SIZE) trace_Count++;
+
+    if (State==TRACE_TRIGGERED && --trace_Remaining==0) trace_freeze();
+}
+
+
+
+
+// Initialize the trace
+void trace_init()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        trace_State=TRACE_OFF;
+        trace_EdgesEnabled=false;
+        trace_Triggers=0;
+        trace_Head=0;
+        trace_Count=0;
+    }
+    trace_setPost(TRACE_SIZE/2);
+}
+
+
+// Clear the buffer and start recording
+void trace_arm(uint8_t Triggers)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        trace_Head=0;
+        trace_Count=0;
+        trace_Triggers=Triggers;
+        trace_PostArmed=trace_Post;
+        trace_FirstTick=true;
+        trace_State=(Triggers==0) ? TRACE_OFF : TRACE_ARMED;
+        trace_EdgesEnabled=(Triggers & TRACE_EDGES)!=0;
+    }
+}
+
+
+// Records after the trigger
+void trace_setPost(uint8_t Post)
+{
+    trace_Post=(Post<TRACE_SIZE) ? Post : TRACE_SIZE-1;
+}
+
+
+// Trigger on a command
+void trace_trigger(uint8_t Cause)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { trace_fire(Cause); }
+}
+
+
+// Record a control tick
+void trace_control(int16_t SpeedCmd, int16_t Speed, int16_t Voltage, uint8_t Hall,
+                   int32_t Position, uint8_t Events)
+{
+    int32_t Delta=trace_FirstTick ? 0 : Position-trace_LastPosition;
+    trace_LastPosition=Position;
+    trace_FirstTick=false;
+    if (trace_State==TRACE_OFF || trace_State==TRACE_FROZEN) return;
+
+    if (Delta>INT8_MAX) Delta=INT8_MAX;
+    if (Delta<INT8_MIN) Delta=INT8_MIN;
+    if (Voltage>4095) Voltage=4095;
+    if (Voltage<-4096) Voltage=-4096;
+    uint16_t VoltageHall=((uint16_t)Voltage<<3) | (Hall & 0x07);
+
+    uint8_t Record[TRACE_RECORD_SIZE];
+    memcpy(&Record[0], &SpeedCmd, sizeof(int16_t));
+    memcpy(&Record[2], &Speed, sizeof(int16_t));
+    memcpy(&Record[4], &VoltageHall, sizeof(uint16_t));
+    Record[6]=(uint8_t)(int8_t)Delta;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        trace_write(Record, false);
+        uint8_t Cause=Events & trace_Triggers & (TRACE_TRIGGER_HALL_ERROR | TRACE_TRIGGER_SATURATION);
+        if (Cause!=0) trace_fire(Cause);
+    }
+}
+
+
+// Record a hall edge (hall interrupt)
+void trace_edge(uint16_t Time, uint16_t Period, uint8_t Hall, uint8_t Count)
+{
+    uint8_t Record[TRACE_RECORD_SIZE];
+    memcpy(&Record[0], &Time, sizeof(uint16_t));
+    memcpy(&Record[2], &Period, sizeof(uint16_t));
+    Record[4]=Hall;
+    Record[5]=Count;
+    Record[6]=0;
+    trace_write(Record, true);
+}
+
+
+// State
+uint8_t trace_getState()
+{
+    return trace_State;
+}
+
+
+// Next dump frame
+uint8_t trace_dump(uint8_t* Buffer)
+{
+    if (trace_State!=TRACE_FROZEN) return TRACE_DUMP_NONE;
+    memset(Buffer, 0, TRACE_DLC);
+
+    if (trace_DumpNext==0)
+    {
+        Buffer[0]=trace_Count;
+        Buffer[1]=trace_PostArmed;
+        Buffer[2]=trace_Cause;
+        memcpy(&Buffer[4], &trace_TriggerTime, sizeof(uint16_t));
+        trace_DumpNext=1;
+        return TRACE_DUMP_HEADER;
+    }
+
+    // Oldest record first
+    uint8_t Index=trace_DumpNext-1;
+    uint8_t Slot=trace_Head+(TRACE_SIZE-trace_Count)+Index;
+    if (Slot>=TRACE_SIZE) Slot-=TRACE_SIZE;
+    Buffer[0]=Index | ((trace_Edges[Slot>>3] & (1<<(Slot & 7))) ? TRACE_INDEX_EDGE : 0);
+    memcpy(&Buffer[1], trace_Buffer[Slot], TRACE_RECORD_SIZE);
+
+    if (++trace_DumpNext>trace_Count) trace_State=TRACE_OFF;
+    return TRACE_DUMP_RECORD;
+}
@@ -0,0 +1,121 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+
+// Number of records in the circular buffer (TRACE_RECORD_SIZE bytes each, 336 bytes of RAM)
+// The largest RAM user of the firmware, see the RAM budget in README.md before growing it
+// 480ms of control ticks at 100Hz, less when the hall edges are recorded
+#define             TRACE_SIZE              48
+
+// Stored record (the dump adds the record index)
+//  control tick : | speed command (int16) | speed (int16) | voltage command << 3 | hall sensors (int16) | position delta (int8) |
+//  hall edge    : | timestamp (uint16) | period (uint16) | hall sensors (uint8) | edge count (uint8) | 0 |
+#define             TRACE_RECORD_SIZE       7
+
+// Trigger sources (mask given to trace_arm), a CAN command (trace_trigger) always triggers an armed trace
+#define             TRACE_TRIGGER_HALL_ERROR    0x01    // Invalid hall sequence
+#define             TRACE_TRIGGER_SATURATION    0x02    // Speed controller output bounded
+#define             TRACE_TRIGGER_CAN           0x04    // Command (cause reported in the header only)
+#define             TRACE_EDGES                 0x10    // Option : the hall edges are recorded between the control ticks
+
+// Dump frames (8 bytes, little endian)
+//  header : | records (uint8) | records after the trigger (uint8) | trigger cause (uint8) | 0 | trigger time [4us] (uint16) | 0 | 0 |
+//  record : | index (uint8, oldest first, bit 7 set for a hall edge) | stored record (7 bytes) |
+#define             TRACE_DLC               8
+#define             TRACE_DUMP_NONE         0
+#define             TRACE_DUMP_HEADER       1
+#define             TRACE_DUMP_RECORD       2
+#define             TRACE_INDEX_EDGE        0x80
+
+// Trace states
+#define             TRACE_OFF               0       // Not recording
+#define             TRACE_ARMED             1       // Recording, waiting for a trigger
+#define             TRACE_TRIGGERED         2       // Recording the records after the trigger
+#define             TRACE_FROZEN            3       // Buffer complete, being dumped
+
+
+
+
+extern volatile bool    trace_EdgesEnabled;
+
+
+
+
+/*!
+ * \brief trace_init    Initialize the trace (off), post-trigger length TRACE_SIZE/2
+ */
+void            trace_init();
+
+
+/*!
+ * \brief trace_arm     Clear the buffer and start recording (main context)
+ * \param Triggers      Trigger sources (TRACE_TRIGGER_...) and options (TRACE_EDGES), 0 stops the trace
+ */
+void            trace_arm(uint8_t Triggers);
+
+
+/*!
+ * \brief trace_setPost Number of records kept after the trigger (the others are before), applied by the next trace_arm
+ * \param Post          Records after the trigger, bounded to TRACE_SIZE-1 (the trigger record is kept)
+ */
+void            trace_setPost(uint8_t Post);
+
+
+/*!
+ * \brief trace_trigger Trigger an armed trace (main context)
+ * \param Cause         Trigger source reported in the header (TRACE_TRIGGER_...)
+ */
+void            trace_trigger(uint8_t Cause);
+
+
+/*!
+ * \brief trace_control Record one control tick (main context, once per control period)
+ *                      The trace triggers when Events contains an armed trigger source
+ * \param SpeedCmd      Speed command [1/64 rad.s-1]
+ * \param Speed         Measured speed [1/64 rad.s-1]
+ * \param Voltage       Voltage command [PWM], 13 bits signed
+ * \param Hall          Hall sensors ( |0|0|0|0|0|H3|H2|H1| )
+ * \param Position      Hall position [ticks], the change since the previous tick is recorded (saturated to int8)
+ * \param Events        Trigger sources active during this tick (TRACE_TRIGGER_...)
+ */
+void            trace_control(int16_t SpeedCmd, int16_t Speed, int16_t Voltage, uint8_t Hall,
+                              int32_t Position, uint8_t Events);
+
+
+/*!
+ * \brief trace_edge    Record one hall edge (hall interrupt, see trace_onEdge)
+ */
+void            trace_edge(uint16_t Time, uint16_t Period, uint8_t Hall, uint8_t Count);
+
+
+/*!
+ * \brief trace_onEdge  Record one hall edge if the option is enabled (no call otherwise)
+ * \param Time          Edge timestamp [timebase ticks]
+ * \param Period        Time since the previous edge [timebase ticks], 0 if unknown
+ * \param Hall          Hall sensors
+ * \param Count         Edge counter
+ */
+static inline void trace_onEdge(uint16_t Time, uint16_t Period, uint8_t Hall, uint8_t Count)
+{
+    if (trace_EdgesEnabled) trace_edge(Time, Period, Hall, Count);
+}
+
+
+/*!
+ * \brief trace_getState    Getter on the trace state (TRACE_OFF, TRACE_ARMED, TRACE_TRIGGERED or TRACE_FROZEN)
+ */
+uint8_t         trace_getState();
+
+
+/*!
+ * \brief trace_dump    Encode the next frame of a frozen trace (main context), the header then the records
+ *                      oldest first. The trace is off once the last record is encoded
+ * \param Buffer        Destination, TRACE_DLC bytes
+ * \return              TRACE_DUMP_NONE (nothing to send), TRACE_DUMP_HEADER or TRACE_DUMP_RECORD
+ */
+uint8_t         trace_dump(uint8_t* Buffer);
+
+
+#endif // TRACE_H
@@ -0,0 +1,55 @@
+#ifndef TEST_MOTOR_H
+#define TEST_MOTOR_H
+
+#include "hal.h"
+#include "bldc.h"
+#include <math.h>
+
+
+// Simulated motor for the host tests : hall sensors on the pins and sinusoidal back-EMF of the phases
+// The electrical angle increases when the motor turns CW (bldc_SectorAngle)
+
+
+#define DEGREES             (M_PI/180)
+
+// Electrical angle entering the sector BLDC_PHASE_I in the CW direction
+#define SECTOR_I_ANGLE      (210*DEGREES)
+
+// Hall sensors ( |H3|H2|H1| ) of the sectors in the CW order
+static const uint8_t motor_CwSequence[6]={ BLDC_PHASE_I, BLDC_PHASE_II, BLDC_PHASE_III, BLDC_PHASE_IV, BLDC_PHASE_V, BLDC_PHASE_VI };
+
+
+/*!
+ * \brief motor_applySensors    Apply the sensor values on the pins (H1 PD7, H2 PD5, H3 PC6) and raise the pin change interrupt
+ */
+static inline void motor_applySensors(uint8_t Sensors)
+{
+    host_setPins(2, ((Sensors & 1)<<7) | (((Sensors>>1) & 1)<<5));
+    host_setPins(1, ((Sensors>>2) & 1)<<6);
+    host_interrupt(PCINT2_vect_num);
+}
+
+
+/*!
+ * \brief motor_sectorOf    Sector of an electrical angle (index in motor_CwSequence)
+ */
+static inline uint8_t motor_sectorOf(double Angle)
+{
+    double Sectors=fmod(Angle-SECTOR_I_ANGLE, 2*M_PI);
+    if (Sectors<0) Sectors+=2*M_PI;
+    return (uint8_t)(Sectors/(60*DEGREES)) % 6;
+}
+
+
+/*!
+ * \brief motor_backEmf     Back-EMF shape of a phase (in phase with the voltage applied 90 degrees ahead of the rotor)
+ * \param Phase             0, 1 or 2 (PSC channel)
+ * \param Angle             Electrical angle [rad]
+ */
+static inline double motor_backEmf(uint8_t Phase, double Angle)
+{
+    return -sin(Angle-Phase*120*DEGREES);
+}
+
+
+#endif // TEST_MOTOR_H
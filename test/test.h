@@ -0,0 +1,40 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+
+// Host unit tests (make test) : one executable per test/test_<module>.cpp, linked with the host library (make host-lib).
+// A failed check prints its location and the test continues, main returns the number of failed checks.
+
+
+extern int test_failures;
+
+/*!
+ * \brief TEST_CHECK        Check a condition
+ */
+#define TEST_CHECK(Condition) \
+    do { if (!(Condition)) { test_failures++; printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #Condition); } } while (0)
+
+/*!
+ * \brief TEST_EQUAL        Check that two integer values are equal
+ */
+#define TEST_EQUAL(Value, Expected) \
+    do { long long value_ = (Value), expected_ = (Expected); \
+         if (value_ != expected_) { test_failures++; printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #Value, value_, expected_); } } while (0)
+
+/*!
+ * \brief TEST_RUN          Run a test function and print its name
+ */
+#define TEST_RUN(Test) \
+    ((void)printf("%s\n", #Test), Test())
+
+/*!
+ * \brief TEST_MAIN         Define the failure counter, run the test functions given as a list and report
+ */
+#define TEST_MAIN(...) \
+    int test_failures = 0; \
+    int main() { __VA_ARGS__; printf(test_failures ? "FAILED (%d)\n" : "OK\n", test_failures); return test_failures != 0; }
+
+
+#endif // TEST_H
@@ -0,0 +1,154 @@
+#include "test.h"
+#include "hal.h"
+#include "bldc.h"
+#include "timebase.h"
+#include "motor.h"
+
+
+// Torque ripple of the six-step and sinusoidal drives at constant speed
+// Motor model : sinusoidal back-EMF, star connection, quasi-static resistive phases (low speed, no inductance),
+// the phase voltages are the PSC duty-cycles averaged over a PWM period. The torque is the sum of the phase
+// currents times the back-EMF shapes, sampled every 10us over whole electrical revolutions.
+
+
+#define SAMPLE_CYCLES       160                                     // Sampling period [CPU cycles] (10us)
+#define SINE_UPDATE_CYCLES  (F_CPU/BLDC_SINE_UPDATE_HZ)             // Timer0 compare period [CPU cycles]
+
+
+// Average phase voltage of a channel [duty-cycle fraction], NAN if floating
+// Both outputs enabled : complementary PWM, low side output only : phase grounded
+static double phaseVoltage(uint8_t Channel)
+{
+    uint8_t Config=POC>>(2*Channel);
+    if (Config & 0b01) return (double)(&POCR0SA)[3*Channel]/BLDC_DUTY_MAX;
+    if (Config & 0b10) return 0;
+    return NAN;
+}
+
+
+// Torque [back-EMF constant x duty-cycle / phase resistance] at an electrical angle
+static double torque(double Angle)
+{
+    double v[3], e[3], neutral=0;
+    uint8_t connected=0;
+    for (uint8_t k=0; k<3; k++)
+    {
+        v[k]=phaseVoltage(k);
+        e[k]=motor_backEmf(k, Angle);
+        if (!isnan(v[k])) { neutral+=v[k]; connected++; }
+    }
+    if (connected<2) return 0;
+    neutral/=connected;
+    double t=0;
+    for (uint8_t k=0; k<3; k++) if (!isnan(v[k])) t+=(v[k]-neutral)*e[k];
+    return t;
+}
+
+
+// Run the motor CW at a constant electrical speed and return the torque ripple (max - min) / mean
+static double torqueRipple(uint8_t Mode, double ElectricalSpeed, double* Mean)
+{
+    host_reset();
+    timebase_init();
+    double angle=SECTOR_I_ANGLE+30*DEGREES;
+    uint8_t sector=motor_sectorOf(angle);
+    motor_applySensors(motor_CwSequence[sector]);
+    bldc_init();
+    bldc_setDriveMode(Mode);
+    bldc_setSpeed(-BLDC_DUTY_MAX/2);                              // Negative : CW
+
+    double step=ElectricalSpeed*SAMPLE_CYCLES/F_CPU;
+    uint32_t samples=(uint32_t)(2*M_PI/step);
+    uint64_t nextSineUpdate=SINE_UPDATE_CYCLES;
+    double minimum=1e9, maximum=-1e9, sum=0;
+    for (uint32_t i=0; i<4*samples; i++)
+    {
+        host_advance(SAMPLE_CYCLES);
+        angle+=step;
+        if (motor_sectorOf(angle)!=sector)
+        {
+            sector=motor_sectorOf(angle);
+            motor_applySensors(motor_CwSequence[sector]);
+        }
+        if (host_getTime()>=nextSineUpdate)
+        {
+            nextSineUpdate+=SINE_UPDATE_CYCLES;
+            if (TIMSK0 & (1<<OCIE0A)) host_interrupt(TIMER0_COMPA_vect_num);
+        }
+
+        // Three revolutions to settle (edge periods known), then one measured
+        if (i<3*samples) continue;
+        double t=torque(angle);
+        if (t<minimum) minimum=t;
+        if (t>maximum) maximum=t;
+        sum+=t;
+    }
+    bldc_disableMotor();
+    *Mean=sum/samples;
+    return (maximum-minimum)/(*Mean);
+}
+
+
+// The six-step ripple is the theoretical one (1 - cos 30 over its mean). The sinusoidal ripple comes from the
+// voltage held between two refreshes while the rotor turns (1 - cos of the angle step), plus about 1.5% for the
+// angle interpolation and the cosine table : it only beats six-step below ~1000 electrical rad.s-1
+static void testRipple()
+{
+    static const double speeds[]={ 50.0, 200.0, 800.0 };              // [electrical rad.s-1]
+    const double sixStepTheory=(1-cos(30*DEGREES))/(3/M_PI);
+    for (uint8_t s=0; s<sizeof(speeds)/sizeof(speeds[0]); s++)
+    {
+        double sixStepMean, sineMean;
+        double sixStep=torqueRipple(BLDC_DRIVE_SIXSTEP, speeds[s], &sixStepMean);
+        double sine=torqueRipple(BLDC_DRIVE_SINE, speeds[s], &sineMean);
+        printf("  %5.0f rad/s  six-step ripple %5.2f%% (mean %.3f)  sine ripple %5.2f%% (mean %.3f)\n",
+               speeds[s], 100*sixStep, sixStepMean, 100*sine, sineMean);
+        TEST_CHECK(sixStepMean>0 && sineMean>0);
+        TEST_CHECK(fabs(sixStep-sixStepTheory)<0.02);
+        double refreshStep=speeds[s]/BLDC_SINE_UPDATE_HZ;
+        TEST_CHECK(sine<=1-cos(refreshStep)+0.015);
+        TEST_CHECK(sine<sixStep);
+    }
+}
+
+
+// Fixed channel drivers of the board settings : same compare registers as the runtime driver
+extern m32m1_pwm pwm;
+extern volatile bool bldc_BoardConfig;
+
+template<uint8_t Channel>
+static void checkBoardChannel(uint16_t DutyCycle)
+{
+    volatile uint16_t* Compare=&POCR0SA+3*Channel;
+    pwm.setDutyCycle(Channel, DutyCycle);
+    uint16_t RuntimeSA=Compare[0], RuntimeSB=Compare[2];
+    Compare[0]=0;
+    Compare[2]=0;
+    m32m1_psc_channel<Channel, BLDC_PWM_CONFIG.deadTimeNbCycles, BLDC_PWM_CONFIG.counterMax>::setDutyCycle(DutyCycle);
+    TEST_EQUAL(Compare[0], RuntimeSA);
+    TEST_EQUAL(Compare[2], RuntimeSB);
+}
+
+static void testBoardChannels()
+{
+    host_reset();
+    bldc_disableMotor();
+    bldc_begin();
+    TEST_CHECK(bldc_BoardConfig);
+    static const uint16_t duties[]={ 0, 1, BLDC_DUTY_MAX/2, BLDC_DUTY_MAX, BLDC_DUTY_MAX+100 };
+    for (uint8_t i=0; i<sizeof(duties)/sizeof(duties[0]); i++)
+    {
+        checkBoardChannel<0>(duties[i]);
+        checkBoardChannel<1>(duties[i]);
+        checkBoardChannel<2>(duties[i]);
+    }
+
+    // Other settings at runtime : the runtime driver is used until the board settings are back
+    TEST_CHECK(bldc_setPwmFrequency(PWM_FREQUENCY_HZ/2, PWM_DEADTIME_NS));
+    TEST_CHECK(!bldc_BoardConfig);
+    TEST_CHECK(bldc_setPwmFrequency(PWM_FREQUENCY_HZ, PWM_DEADTIME_NS));
+    TEST_CHECK(bldc_BoardConfig);
+}
+
+
+TEST_MAIN(TEST_RUN(testRipple), TEST_RUN(testBoardChannels))
@@ -0,0 +1,122 @@
+#include "test.h"
+#include "hal.h"
+#include "cantx.h"
+#include <avr/interrupt.h>
+
+
+// CAN transmit queue on the simulated controller (the MObs are sent by number)
+
+
+ISR(CAN_INT_vect)
+{
+    cantx_onInterrupt();
+}
+
+
+// Controller enabled, empty queue, interrupts enabled
+static void setUp()
+{
+    host_reset();
+    CANGIE=(1<<ENIT);
+    cantx_init();
+    sei();
+}
+
+
+// Enqueue a frame numbered by its first data byte
+static bool send(uint16_t Id, uint8_t Number)
+{
+    return cantx_send(Id, 1, &Number);
+}
+
+
+// Transmit the next frame and check it
+static void expect(uint16_t Id, uint8_t Number)
+{
+    host_can_frame_t Frame;
+    TEST_CHECK(host_canTransmit(&Frame));
+    TEST_EQUAL(Frame.id, Id);
+    TEST_EQUAL(Frame.data[0], Number);
+}
+
+
+// Frames with the same identifier keep their order, a freed low MOb is not loaded before the higher ones are sent
+static void testSameIdOrder()
+{
+    setUp();
+    for (uint8_t i=0; i<6; i++) TEST_CHECK(send(0x36, i));
+    TEST_EQUAL(cantx_getLevel(), 3);
+    for (uint8_t i=0; i<6; i++) expect(0x36, i);
+    host_can_frame_t Frame;
+    TEST_CHECK(!host_canTransmit(&Frame));
+}
+
+
+// The queue sorts the waiting frames, a higher priority frame waits for the frames already loaded
+static void testPriority()
+{
+    setUp();
+    send(0x35, 0);
+    send(0x35, 1);
+    send(0x36, 2);
+    send(0x36, 3);
+    send(0x31, 4);
+    send(0x10, 5);
+    expect(0x35, 0);
+    expect(0x35, 1);
+    expect(0x36, 2);
+    expect(0x10, 5);
+    expect(0x31, 4);
+    expect(0x36, 3);
+}
+
+
+// Queue full : the lowest priority frame is discarded (the new one or the last queued)
+static void testQueueFull()
+{
+    setUp();
+    for (uint8_t i=0; i<3+CANTX_QUEUE_SIZE; i++) TEST_CHECK(send(0x30, i));
+    TEST_EQUAL(cantx_getLevel(), CANTX_QUEUE_SIZE);
+    TEST_CHECK(!send(0x30, 100));
+    TEST_CHECK(!send(0x31, 101));
+    TEST_CHECK(send(0x20, 102));
+    TEST_EQUAL(cantx_getLevel(), CANTX_QUEUE_SIZE);
+
+    cantx_stats_t Stats;
+    cantx_getStats(&Stats);
+    TEST_EQUAL(Stats.dropped, 2);
+    TEST_EQUAL(Stats.overruns, 1);
+    TEST_EQUAL(Stats.maxLevel, CANTX_QUEUE_SIZE);
+
+    for (uint8_t i=0; i<3; i++) expect(0x30, i);
+    expect(0x20, 102);
+    for (uint8_t i=3; i<2+CANTX_QUEUE_SIZE; i++) expect(0x30, i);
+    cantx_getStats(&Stats);
+    TEST_EQUAL(Stats.sent, 3+CANTX_QUEUE_SIZE);
+    TEST_EQUAL(cantx_getLevel(), 0);
+}
+
+
+// Bus-off : the loaded and queued frames are dropped, the controller is enabled again and the next frames are sent
+static void testBusOff()
+{
+    setUp();
+    for (uint8_t i=0; i<5; i++) send(0x31, i);
+    host_canBusOff();
+
+    cantx_stats_t Stats;
+    cantx_getStats(&Stats);
+    TEST_EQUAL(Stats.busOff, 1);
+    TEST_EQUAL(Stats.dropped, 5);
+    TEST_EQUAL(cantx_getLevel(), 0);
+    TEST_EQUAL(CANGIT & (1<<BOFFIT), 0);
+    TEST_CHECK(CANGCON & (1<<ENASTB));
+    host_can_frame_t Frame;
+    TEST_CHECK(!host_canTransmit(&Frame));
+
+    send(0x31, 10);
+    expect(0x31, 10);
+}
+
+
+TEST_MAIN(TEST_RUN(testSameIdOrder), TEST_RUN(testPriority), TEST_RUN(testQueueFull), TEST_RUN(testBusOff))
@@ -0,0 +1,64 @@
+#include "test.h"
+#include "hal.h"
+#include "current.h"
+
+
+// Direction of the current controller output near zero
+
+
+#define GAIN_ONE            1024                    // Q6.10
+
+
+// Output for a voltage feedforward, no current measured and no current command (proportional gain only)
+static int16_t outputFor(int16_t Feedforward)
+{
+    current_setCommand(0, Feedforward);
+    return current_update(0);
+}
+
+
+// Feedforward alternating around zero within the band : the direction is kept
+static void testZeroBand()
+{
+    host_reset();
+    current_init(GAIN_ONE, 0, CURRENT_ERROR_MAX);
+
+    for (uint8_t i=0; i<10; i++)
+    {
+        TEST_EQUAL(outputFor(2), 2);
+        TEST_EQUAL(outputFor(-2), 0);
+    }
+
+    // Past the band : negative direction, kept within the band
+    TEST_EQUAL(outputFor(-CURRENT_ZERO_BAND-1), -CURRENT_ZERO_BAND-1);
+    for (uint8_t i=0; i<10; i++)
+    {
+        TEST_EQUAL(outputFor(-2), -2);
+        TEST_EQUAL(outputFor(2), -1);
+        TEST_EQUAL(outputFor(0), -1);
+    }
+
+    // Past the band again : positive direction
+    TEST_EQUAL(outputFor(CURRENT_ZERO_BAND+1), CURRENT_ZERO_BAND+1);
+    TEST_EQUAL(outputFor(-CURRENT_ZERO_BAND), 0);
+}
+
+
+// The measured current is signed as the output direction (DC link current, sign of the power)
+static void testMeasuredSign()
+{
+    host_reset();
+    current_init(GAIN_ONE, 0, CURRENT_ERROR_MAX);
+
+    // Positive direction : a positive sample lowers the output
+    current_setCommand(0, 100);
+    TEST_EQUAL(current_update(10), 90);
+
+    // Negative direction : a positive sample raises the output towards zero
+    current_setCommand(0, -100);
+    TEST_EQUAL(current_update(0), -100);
+    TEST_EQUAL(current_update(10), -90);
+}
+
+
+TEST_MAIN(TEST_RUN(testZeroBand), TEST_RUN(testMeasuredSign))
@@ -0,0 +1,79 @@
+#include "test.h"
+#include "fixed.h"
+#include "bldc.h"
+
+
+// Fixed-point control chain (CONTROL_FIXED_POINT=1) against the soft-float reference : the voltage command
+// (speed command integration, clamp, speed to PWM scaling) must agree within one PWM step
+
+
+// Constants of the control chain (MotorBoard.cpp)
+#define M_SPEEDCONST        0.0330
+#define M_VOLTAGE           12
+#define ACCEL_REFRESH_HZ    100
+#define VOLTS_TO_PWM_RATIO  (BLDC_DUTY_MAX/M_VOLTAGE)
+#define SPEED_TO_PWM        (VOLTS_TO_PWM_RATIO * M_SPEEDCONST)
+#define SPEED_CMD_MAX_RADS  (BLDC_DUTY_MAX/SPEED_TO_PWM)
+#define SPEED_TO_PWM_Q10    Q_FROM_CONST(SPEED_TO_PWM,10)
+#define SPEED_CMD_MAX_Q16   Q16_FROM_CONST(SPEED_CMD_MAX_RADS)
+
+
+// Voltage command of the fixed-point chain [PWM]
+static int16_t fixedVoltage(q16_t speed_cmd_q16)
+{
+    return q16_toInt(q16_mulQ10(speed_cmd_q16, SPEED_TO_PWM_Q10));
+}
+
+
+// Voltage command of the float chain [PWM] (converted to Q16.16 for the speed controller, then truncated)
+static int16_t floatVoltage(float speed_cmd_rads)
+{
+    return q16_toInt(q16_fromFloat(VOLTS_TO_PWM_RATIO * M_SPEEDCONST * speed_cmd_rads));
+}
+
+
+// Every speed command of the range, by steps of 2^-8 rad.s-1
+static void testScalingSweep()
+{
+    int16_t worst=0;
+    for (q16_t speed=-SPEED_CMD_MAX_Q16; speed<=SPEED_CMD_MAX_Q16; speed+=(1<<8))
+    {
+        int16_t delta=fixedVoltage(speed)-floatVoltage(q16_toFloat(speed));
+        if (delta<0) delta=-delta;
+        if (delta>worst) worst=delta;
+    }
+    printf("  worst |delta| = %d PWM\n", worst);
+    TEST_CHECK(worst<=1);
+    TEST_CHECK(fixedVoltage(SPEED_CMD_MAX_Q16)<=BLDC_DUTY_MAX);
+    TEST_CHECK(fixedVoltage(-SPEED_CMD_MAX_Q16)>=-BLDC_DUTY_MAX);
+}
+
+
+// Acceleration commands integrated up to the saturation and back, both chains side by side
+static void testIntegration()
+{
+    static const float accels[]={ 1.0f, -3.7f, 250.0f, -1000.0f, 0.01f, 12345.0f, -0.3f };
+    int16_t worst=0;
+    for (uint8_t a=0; a<sizeof(accels)/sizeof(accels[0]); a++)
+    {
+        q16_t accel_step_q16=q16_clamp(q16_fromFloat(accels[a] / ACCEL_REFRESH_HZ), SPEED_CMD_MAX_Q16);
+        q16_t speed_cmd_q16=0;
+        float speed_cmd_rads=0;
+        for (uint16_t tick=0; tick<20000; tick++)
+        {
+            speed_cmd_q16=q16_clamp(speed_cmd_q16 + accel_step_q16, SPEED_CMD_MAX_Q16);
+            speed_cmd_rads=speed_cmd_rads + accels[a] / ACCEL_REFRESH_HZ;
+            if (speed_cmd_rads > SPEED_CMD_MAX_RADS) speed_cmd_rads = SPEED_CMD_MAX_RADS;
+            if (speed_cmd_rads < -SPEED_CMD_MAX_RADS) speed_cmd_rads = -SPEED_CMD_MAX_RADS;
+
+            int16_t delta=fixedVoltage(speed_cmd_q16)-floatVoltage(speed_cmd_rads);
+            if (delta<0) delta=-delta;
+            if (delta>worst) worst=delta;
+        }
+    }
+    printf("  worst |delta| = %d PWM\n", worst);
+    TEST_CHECK(worst<=1);
+}
+
+
+TEST_MAIN(TEST_RUN(testScalingSweep), TEST_RUN(testIntegration))
@@ -0,0 +1,83 @@
+#include "test.h"
+#include "hal.h"
+
+
+// Host hardware abstraction layer : the modelled registers behave as on the target
+
+
+// Request a transmission in a MOb
+static void loadMob(uint8_t Mob, uint16_t Id)
+{
+    CANPAGE=(Mob<<4);
+    CANIDT1=(uint8_t)(Id>>3);
+    CANIDT2=(uint8_t)((Id & 0x007)<<5);
+    CANIDT4=0;
+    CANMSG=Mob;
+    CANCDMOB=(1<<CONMOB0) | 1;
+}
+
+
+// A one written to PINx toggles PORTx, only on that pin
+static void testPinToggle()
+{
+    host_reset();
+    DDRB=0xFF;
+    PORTB=0xA5;
+    PINB=(1<<3);
+    TEST_EQUAL(PORTB, 0xAD);
+    TEST_EQUAL(PINB, 0xAD);
+    PINB=(1<<3);
+    TEST_EQUAL(PORTB, 0xA5);
+    PINB=0;
+    TEST_EQUAL(PORTB, 0xA5);
+}
+
+
+// PINx reads the outputs from PORTx and the inputs from the outside
+static void testPinLevels()
+{
+    host_reset();
+    DDRD=0x0F;
+    PORTD=0x03;
+    host_setPins(2, 0xF0 | 0x0C);
+    TEST_EQUAL(PIND, 0xF3);
+    DDRD=0x00;
+    TEST_EQUAL(PIND, 0xFC);
+}
+
+
+// The lowest MOb number is sent first, whatever the identifiers
+static void testTransmitOrder()
+{
+    host_reset();
+    loadMob(5, 0x010);
+    loadMob(0, 0x300);
+    loadMob(4, 0x020);
+    host_can_frame_t Frame;
+    TEST_CHECK(host_canTransmit(&Frame));
+    TEST_EQUAL(Frame.id, 0x300);
+    TEST_EQUAL(Frame.data[0], 0);
+    TEST_CHECK(host_canTransmit(&Frame));
+    TEST_EQUAL(Frame.id, 0x020);
+    TEST_CHECK(host_canTransmit(&Frame));
+    TEST_EQUAL(Frame.id, 0x010);
+    TEST_EQUAL(Frame.data[0], 5);
+    TEST_CHECK(!host_canTransmit(&Frame));
+}
+
+
+// CANGIT is cleared by writing one, the bus-off raises the CAN interrupt once enabled
+static void testBusOff()
+{
+    host_reset();
+    host_canBusOff();
+    TEST_CHECK(CANGIT & (1<<BOFFIT));
+    TEST_CHECK(CANGSTA & (1<<BOFF));
+    CANGIT=0;
+    TEST_CHECK(CANGIT & (1<<BOFFIT));
+    CANGIT=(1<<BOFFIT);
+    TEST_EQUAL(CANGIT, 0);
+}
+
+
+TEST_MAIN(TEST_RUN(testPinToggle), TEST_RUN(testPinLevels), TEST_RUN(testTransmitOrder), TEST_RUN(testBusOff))
@@ -0,0 +1,117 @@
+#include "test.h"
+#include "hal.h"
+#include "hall.h"
+#include "timebase.h"
+#include "mailbox.h"
+
+
+// Hall position : 32-bit counter kept by the interrupt, extended to 64 bits by hall_getPosition
+
+
+// Sensor values ( |H3|H2|H1| ) in the CCW order (the position increases)
+static const uint8_t ccwSequence[6]={ 0b101, 0b100, 0b110, 0b010, 0b011, 0b001 };
+static uint8_t motorSector;
+
+// Position counter of the interrupt (hall.cpp)
+extern mailbox_seqlock<uint32_t> hall_Position;
+
+
+// Apply the sensor values on the pins (H1 PD7, H2 PD5, H3 PC6) and raise the pin change interrupt
+static void applySensors(uint8_t Sensors)
+{
+    host_setPins(2, ((Sensors & 1)<<7) | (((Sensors>>1) & 1)<<5));
+    host_setPins(1, ((Sensors>>2) & 1)<<6);
+    host_interrupt(PCINT2_vect_num);
+}
+
+
+// Move by a number of edges (positive : CCW)
+static void move(int32_t Edges)
+{
+    for (; Edges>0; Edges--) applySensors(ccwSequence[motorSector=(motorSector+1)%6]);
+    for (; Edges<0; Edges++) applySensors(ccwSequence[motorSector=(motorSector+5)%6]);
+}
+
+
+// Sensors on the first sector, position set
+static void setUp(int64_t Position)
+{
+    host_reset();
+    timebase_init();
+    motorSector=0;
+    applySensors(ccwSequence[0]);
+    hall_init();
+    hall_setPosition(Position);
+    sei();
+}
+
+
+// The 32-bit counter wraps, the extended position and the differences do not
+static void testWrapForward()
+{
+    setUp(INT32_MAX-2);
+    int32_t before=hall_getPosition32();
+    move(5);
+    TEST_EQUAL(hall_getPosition32(), (int64_t)INT32_MIN+2);
+    TEST_EQUAL(hall_getPosition(), (int64_t)INT32_MAX+3);
+    TEST_EQUAL((int32_t)((uint32_t)hall_getPosition32()-(uint32_t)before), 5);
+}
+
+
+// Backward across zero and across the negative wrap
+static void testWrapBackward()
+{
+    setUp(2);
+    move(-5);
+    TEST_EQUAL(hall_getPosition32(), -3);
+    TEST_EQUAL(hall_getPosition(), -3);
+
+    setUp((int64_t)INT32_MIN+1);
+    move(-3);
+    TEST_EQUAL(hall_getPosition32(), (int64_t)INT32_MAX-1);
+    TEST_EQUAL(hall_getPosition(), (int64_t)INT32_MIN-2);
+}
+
+
+// Several wraps of the 32-bit counter, hall_getPosition called between them (less than 2^31 steps apart)
+static void testMultipleWraps()
+{
+    const int64_t start=((int64_t)5<<32)-7;
+    const uint32_t jump=0x7FFFFFF0;
+    setUp(start);
+    int64_t expected=start;
+    for (uint8_t round=0; round<6; round++)
+    {
+        move(10);
+        expected+=10;
+        TEST_EQUAL(hall_getPosition(), expected);
+
+        // As if the interrupt had counted 2^31-16 more edges (the extended position is not touched)
+        cli();
+        hall_Position.write(hall_Position.last()+jump);
+        sei();
+        expected+=jump;
+        TEST_EQUAL(hall_getPosition(), expected);
+    }
+    move(-30);
+    TEST_EQUAL(hall_getPosition(), expected-30);
+    TEST_EQUAL(hall_getPosition32(), (int32_t)(uint32_t)(expected-30));
+}
+
+
+// A sensor error keeps counting in the previous direction
+static void testErrorKeepsDirection()
+{
+    setUp(0);
+    move(3);
+    uint8_t errors=hall_getErrorCount();
+    applySensors(ccwSequence[motorSector=(motorSector+2)%6]);
+    TEST_EQUAL(hall_getErrorCount(), errors+1);
+    TEST_CHECK(hall_getError());
+    TEST_EQUAL(hall_getPosition(), 4);
+    move(1);
+    TEST_EQUAL(hall_getPosition(), 5);
+}
+
+
+TEST_MAIN(TEST_RUN(testWrapForward), TEST_RUN(testWrapBackward), TEST_RUN(testMultipleWraps), TEST_RUN(testErrorKeepsDirection))
@@ -0,0 +1,46 @@
+#include "test.h"
+#include "hal.h"
+#include "led.h"
+
+
+// LED on PORTB, the other pins of the port (PSC outputs) must keep their state
+
+
+// The toggle only changes the LED pin
+static void testToggle()
+{
+    host_reset();
+    DDRB=0xFF;
+    PORTB=0xC1;
+    Output output(&PORTB, 3);
+    TEST_EQUAL(PORTB, 0xC9);
+    output.toggle();
+    TEST_EQUAL(PORTB, 0xC1);
+    output.toggle();
+    TEST_EQUAL(PORTB, 0xC9);
+}
+
+
+// Non-blocking blink : count blinks, then the LED stays off
+static void testBlink()
+{
+    host_reset();
+    PORTB=0x81;
+    LED led(&PORTB, 3, 0);
+    led.startBlink(2, 10, 0);
+    uint8_t changes=0;
+    uint8_t last=PORTB;
+    for (uint16_t now=0; now<100; now++)
+    {
+        led.update(now);
+        if (PORTB!=last) changes++;
+        TEST_EQUAL(PORTB & ~(1<<3), 0x81);
+        last=PORTB;
+    }
+    TEST_EQUAL(changes, 4);
+    TEST_CHECK(!led.isBlinking());
+    TEST_EQUAL(PORTB, 0x89);
+}
+
+
+TEST_MAIN(TEST_RUN(testToggle), TEST_RUN(testBlink))
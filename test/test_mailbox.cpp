@@ -0,0 +1,118 @@
+#include "test.h"
+#include "hal.h"
+#include "mailbox.h"
+
+
+// Lock-free handoffs stressed with an interrupt injected at every instruction boundary (host_step) :
+// the copy seen by the other side must be a whole published value, never a mix of two
+// The host instructions are not the AVR ones, the test checks the protocol (order of the accesses and retries)
+
+
+// Value spread over several words : consistent when all the words are equal
+typedef struct
+{
+    uint32_t    words[8];
+} sample_t;
+
+static sample_t makeSample(uint32_t Value)
+{
+    sample_t Sample;
+    for (uint8_t i=0; i<8; i++) Sample.words[i]=Value;
+    return Sample;
+}
+
+static bool isWhole(const sample_t& Sample)
+{
+    for (uint8_t i=1; i<8; i++) if (Sample.words[i]!=Sample.words[0]) return false;
+    return true;
+}
+
+
+// Shared state of the stepped function and the injected interrupt
+static mailbox_seqlock<sample_t> seqlock;
+static mailbox_double<sample_t> doubleBuffer;
+static sample_t plain;
+static sample_t mainCopy;
+static sample_t interruptCopy;
+static uint32_t injectAt;
+static uint32_t published;
+static bool interruptTorn;
+
+
+// Main context readers and writers (stepped)
+static void readSeqlock()   { mainCopy=seqlock.read(); }
+static void readPlain()     { mainCopy=plain; }
+static void writeDouble()   { doubleBuffer.write(makeSample(published+1)); }
+
+// Interrupts injected after the instruction injectAt
+static void onSeqlockStep(uint32_t Step)    { if (Step==injectAt) seqlock.write(makeSample(++published)); }
+static void onPlainStep(uint32_t Step)      { if (Step==injectAt) plain=makeSample(++published); }
+static void onDoubleStep(uint32_t Step)
+{
+    if (Step!=injectAt) return;
+    interruptCopy=doubleBuffer.read();
+    interruptTorn=!isWhole(interruptCopy) || interruptCopy.words[0]<published || interruptCopy.words[0]>published+1;
+}
+
+
+// Interrupt writer, main reader : every boundary of the read, the copy is the old or the new value
+static void testSeqlock()
+{
+    published=1;
+    seqlock.write(makeSample(published));
+    injectAt=UINT32_MAX;
+    uint32_t steps=host_step(readSeqlock, onSeqlockStep);
+    TEST_CHECK(steps>0);
+    uint32_t torn=0;
+    for (injectAt=0; injectAt<steps; injectAt++)
+    {
+        uint32_t before=published;
+        host_step(readSeqlock, onSeqlockStep);
+        if (!isWhole(mainCopy) || mainCopy.words[0]<before || mainCopy.words[0]>published) torn++;
+    }
+    printf("  %u instructions, %u torn copies\n", steps, torn);
+    TEST_EQUAL(torn, 0);
+}
+
+
+// Same injection on a plain copy : the harness does see the torn values
+static void testPlainCopyTears()
+{
+    published=1;
+    plain=makeSample(published);
+    injectAt=UINT32_MAX;
+    uint32_t steps=host_step(readPlain, onPlainStep);
+    uint32_t torn=0;
+    for (injectAt=0; injectAt<steps; injectAt++)
+    {
+        host_step(readPlain, onPlainStep);
+        if (!isWhole(mainCopy)) torn++;
+    }
+    printf("  %u instructions, %u torn copies\n", steps, torn);
+    TEST_CHECK(torn>0);
+}
+
+
+// Main writer, interrupt reader : at every boundary of the write, the interrupt copies the old or the new value
+static void testDoubleBuffer()
+{
+    published=1;
+    doubleBuffer.write(makeSample(published));
+    injectAt=UINT32_MAX;
+    uint32_t steps=host_step(writeDouble, onDoubleStep);
+    published++;
+    uint32_t torn=0;
+    for (injectAt=0; injectAt<steps; injectAt++)
+    {
+        interruptTorn=false;
+        host_step(writeDouble, onDoubleStep);
+        if (interruptTorn) torn++;
+        published++;
+        TEST_CHECK(isWhole(doubleBuffer.read()) && doubleBuffer.read().words[0]==published);
+    }
+    printf("  %u instructions, %u torn copies\n", steps, torn);
+    TEST_EQUAL(torn, 0);
+}
+
+
+TEST_MAIN(TEST_RUN(testSeqlock), TEST_RUN(testPlainCopyTears), TEST_RUN(testDoubleBuffer))
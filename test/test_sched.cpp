@@ -0,0 +1,99 @@
+#include "test.h"
+#include "hal.h"
+#include "sched.h"
+#include "timebase.h"
+
+
+// Scheduler realigned by SYNC frames : every task keeps running
+
+
+// Task table of MotorBoard.cpp (ENABLE_PROFILING=1 : with the diagnostics task)
+#define NB_TASKS            6
+static const uint16_t       TaskHz[NB_TASKS]={ 100, 100, 100, 20, 100, 10 };
+
+static uint16_t             runs[NB_TASKS];
+static uint64_t             lastSync;
+static uint64_t             controlDelayMax;
+
+static void controlTask()
+{
+    runs[0]++;
+    if (lastSync==0) return;
+    uint64_t delay=host_getTime()-lastSync;
+    if (delay>controlDelayMax) controlDelayMax=delay;
+}
+static void telemetryTask()     { runs[1]++; }
+static void housekeepingTask()  { runs[2]++; }
+static void legacySpeedTask()   { runs[3]++; }
+static void traceDumpTask()     { runs[4]++; }
+static void diagnosticsTask()   { runs[5]++; }
+
+static const sched_task_t tasks[NB_TASKS] = {
+    // task                 period [ticks]          phase   priority
+    { controlTask,          SCHED_HZ_TO_TICKS(100), 0,      0 },
+    { telemetryTask,        SCHED_HZ_TO_TICKS(100), 0,      1 },
+    { housekeepingTask,     SCHED_HZ_TO_TICKS(100), 5,      2 },
+    { legacySpeedTask,      SCHED_HZ_TO_TICKS(20),  25,     3 },
+    { traceDumpTask,        SCHED_HZ_TO_TICKS(100), 3,      4 },
+    { diagnosticsTask,      SCHED_HZ_TO_TICKS(10),  55,     5 },
+};
+
+
+// One simulated second with a SYNC every SyncMs (0 : none), the SYNC is received between two ticks
+static void runSecond(uint16_t SyncMs)
+{
+    host_reset();
+    timebase_init();
+    TEST_CHECK(sched_init(tasks, NB_TASKS));
+    sched_start();
+    sei();
+    for (uint8_t i=0; i<NB_TASKS; i++) runs[i]=0;
+    lastSync=0;
+    controlDelayMax=0;
+
+    uint64_t Sync=(uint64_t)SyncMs*(F_CPU/1000);
+    while (host_getTime()<F_CPU)
+    {
+        sched_run();
+        if (SyncMs!=0 && host_getTime()>=Sync)
+        {
+            host_advance(F_CPU/4000);
+            lastSync=host_getTime();
+            cli();
+            sched_realign(TCNT1);
+            sei();
+            Sync+=(uint64_t)SyncMs*(F_CPU/1000);
+        }
+    }
+
+    printf("  SYNC %3ums :", SyncMs);
+    for (uint8_t i=0; i<NB_TASKS; i++) printf(" %u", runs[i]);
+    printf(" runs, control %.2fms after SYNC at most\n", (double)controlDelayMax*1000/F_CPU);
+
+    // Every task runs at its rate (the SYNC may skip part of a period)
+    for (uint8_t i=0; i<NB_TASKS; i++) TEST_CHECK(runs[i]>=TaskHz[i]*8/10);
+}
+
+
+static void testFreeRunning()
+{
+    runSecond(0);
+}
+
+
+// SYNC at the control rate : the control runs one tick after each SYNC
+static void testSync100Hz()
+{
+    runSecond(10);
+    TEST_CHECK(controlDelayMax<=F_CPU/1000+F_CPU/4000);
+}
+
+
+// SYNC slower than the legacy speed and diagnostics phases
+static void testSync20Hz()
+{
+    runSecond(50);
+}
+
+
+TEST_MAIN(TEST_RUN(testFreeRunning), TEST_RUN(testSync100Hz), TEST_RUN(testSync20Hz))
@@ -0,0 +1,157 @@
+#include "test.h"
+#include "hal.h"
+#include "bldc.h"
+#include "timebase.h"
+#include "motor.h"
+
+
+// Sensorless commutation (BLDC_SENSORLESS=1) : the simulated motor drives the hall sensors and the comparator
+// of each phase (divided phase voltage against the neutral point, high when the back-EMF is positive). The
+// motor turns CW at an imposed speed, the commutations are checked against the rotor angle.
+// The host library must be built with the option : make clean-host test BLDC_SENSORLESS=1
+
+
+#if BLDC_SENSORLESS
+
+#define SAMPLE_CYCLES       32                                      // Sampling period [CPU cycles] (2us)
+
+// Output configuration of the sectors in the CW order (same order as motor_CwSequence)
+static const uint8_t cwConfigurations[6]={ BLDC_SET_Q2L_Q1H, BLDC_SET_Q3L_Q1H, BLDC_SET_Q3L_Q2H,
+                                           BLDC_SET_Q1L_Q2H, BLDC_SET_Q1L_Q3H, BLDC_SET_Q2L_Q3H };
+
+// Simulated motor
+static double motorAngle;
+static uint8_t motorSector;
+static bool comparatorOutputs[3];
+
+// Commutations while sensorless : number and largest angle error
+static uint16_t commutations;
+static double worstError;
+
+
+// Motor at rest in the middle of a sector, driven CW
+static void setUp()
+{
+    bldc_disableMotor();                                            // State left by the previous test
+    host_reset();
+    timebase_init();
+    motorAngle=SECTOR_I_ANGLE+30*DEGREES;
+    motorSector=motor_sectorOf(motorAngle);
+    motor_applySensors(motor_CwSequence[motorSector]);
+    for (uint8_t k=0; k<3; k++) comparatorOutputs[k]=motor_backEmf(k, motorAngle)>0;
+    bldc_init();
+    bldc_setSpeed(-BLDC_DUTY_MAX/2);
+}
+
+
+// Angle of a commutation to the given output configuration, relative to the start of its sector
+static double commutationError(uint8_t Config)
+{
+    for (uint8_t s=0; s<6; s++)
+    {
+        if (cwConfigurations[s]!=Config) continue;
+        double error=fmod(motorAngle-SECTOR_I_ANGLE-s*60*DEGREES, 2*M_PI);
+        if (error>M_PI) error-=2*M_PI;
+        if (error<-M_PI) error+=2*M_PI;
+        return error;
+    }
+    return 2*M_PI;
+}
+
+
+// Turn at an electrical speed for a time, the hall edges and the comparator edges raise their interrupts
+static void run(double ElectricalSpeed, double Seconds)
+{
+    double step=ElectricalSpeed*SAMPLE_CYCLES/F_CPU;
+    for (uint32_t i=0; i<(uint32_t)(Seconds*F_CPU/SAMPLE_CYCLES); i++)
+    {
+        uint8_t config=POC;
+        host_advance(SAMPLE_CYCLES);
+        motorAngle+=step;
+        if (motor_sectorOf(motorAngle)!=motorSector)
+        {
+            motorSector=motor_sectorOf(motorAngle);
+            motor_applySensors(motor_CwSequence[motorSector]);
+        }
+
+        // Comparators : interrupt on the selected edge of the output
+        for (uint8_t k=0; k<3; k++)
+        {
+            bool output=motor_backEmf(k, motorAngle)>0;
+            if (output==comparatorOutputs[k]) continue;
+            comparatorOutputs[k]=output;
+            uint8_t control=(&AC0CON)[k];
+            bool rising=(control & (1<<AC0IS0))!=0;
+            if ((control & (1<<AC0EN)) && (control & (1<<AC0IE)) && (control & (1<<AC0IS1)) && output==rising)
+            {
+                ACSR |= (1<<(AC0IF+k));
+                host_interrupt(ANACOMP0_vect_num+k);
+            }
+        }
+
+        // Commutations done by the zero crossing timer
+        if (POC!=config && bldc_isSensorless())
+        {
+            double error=fabs(commutationError(POC));
+            commutations++;
+            if (error>worstError) worstError=error;
+        }
+    }
+}
+
+
+// Above the handover speed, the commutations follow the zero crossings, 30 degrees later
+static void testHandover()
+{
+    const double speeds[]={ 2000.0, 3000.0 };                       // [electrical rad.s-1]
+    for (uint8_t s=0; s<sizeof(speeds)/sizeof(speeds[0]); s++)
+    {
+        setUp();
+        run(speeds[s], 0.02);
+        TEST_CHECK(bldc_isSensorless());
+
+        commutations=0;
+        worstError=0;
+        run(speeds[s], 0.05);
+        TEST_CHECK(bldc_isSensorless());
+
+        // One sector every 60 degrees, within one timebase tick and one sample of the sector start
+        double expected=speeds[s]*0.05/(60*DEGREES);
+        double resolution=speeds[s]*(1.0/TIMEBASE_HZ+(double)SAMPLE_CYCLES/F_CPU);
+        printf("  %5.0f rad/s  %u commutations (%.0f expected)  worst error %.2f degrees (resolution %.2f)\n",
+               speeds[s], commutations, expected, worstError/DEGREES, resolution/DEGREES);
+        TEST_CHECK(fabs(commutations-expected)<=1);
+        TEST_CHECK(worstError<=2*resolution);
+    }
+}
+
+
+// Below the exit speed the hall sensors take over again
+static void testExit()
+{
+    setUp();
+    run(2500.0, 0.02);
+    TEST_CHECK(bldc_isSensorless());
+    run(800.0, 0.02);
+    TEST_CHECK(!bldc_isSensorless());
+    TEST_EQUAL(POC, cwConfigurations[motorSector]);
+}
+
+
+// Below the handover speed, the hall sensors keep the commutation
+static void testSlow()
+{
+    setUp();
+    run(1200.0, 0.05);
+    TEST_CHECK(!bldc_isSensorless());
+    TEST_EQUAL(POC, cwConfigurations[motorSector]);
+}
+
+
+TEST_MAIN(TEST_RUN(testHandover), TEST_RUN(testExit), TEST_RUN(testSlow))
+
+#else
+
+TEST_MAIN(printf("BLDC_SENSORLESS=0 : skipped (make clean-host test BLDC_SENSORLESS=1)\n"))
+
+#endif
@@ -0,0 +1,76 @@
+#include "test.h"
+#include "speedctrl.h"
+
+
+// Speed controller saturation and anti-windup
+
+
+#define CURRENT_LIMIT       400                                     // Current command bound (MotorBoard.cpp)
+
+extern q16_t speedctrl_Integral;
+
+
+// Saturated on a large error, then the error reverses : number of periods until the output leaves the bound
+static uint16_t recoveryPeriods()
+{
+    speedctrl_init(Q_FROM_CONST(2.0,10), Q_FROM_CONST(0.2,10), Q_FROM_CONST(0.5,10));
+    for (uint16_t i=0; i<500; i++) speedctrl_update(0, Q16_FROM_CONST(100));
+    uint16_t periods=0;
+    while (periods<1000 && speedctrl_update(0, Q16_FROM_CONST(-5))>=CURRENT_LIMIT) periods++;
+    return periods;
+}
+
+
+// Current loop : the output and the integral term stay within the current limit, and the recovery is fast
+static void testCurrentLimit()
+{
+    speedctrl_setOutputMax(CURRENT_LIMIT);
+    speedctrl_init(Q_FROM_CONST(2.0,10), Q_FROM_CONST(0.2,10), Q_FROM_CONST(0.5,10));
+    for (uint16_t i=0; i<500; i++)
+    {
+        TEST_CHECK(speedctrl_update(0, Q16_FROM_CONST(100))<=CURRENT_LIMIT);
+        TEST_CHECK(speedctrl_Integral<=(q16_t)CURRENT_LIMIT<<Q16_FRAC_BITS);
+    }
+    TEST_CHECK(speedctrl_isSaturated());
+
+    uint16_t bounded=recoveryPeriods();
+    speedctrl_setOutputMax(SPEEDCTRL_OUTPUT_MAX);
+    uint16_t unbounded=recoveryPeriods();
+    printf("  recovery : %u periods (bound %d), %u periods (bound %d)\n", bounded, CURRENT_LIMIT, unbounded, SPEEDCTRL_OUTPUT_MAX);
+    TEST_CHECK(bounded<=2 && unbounded>bounded);
+}
+
+
+// Default bound : the PWM range
+static void testDefaultBound()
+{
+    speedctrl_setOutputMax(SPEEDCTRL_OUTPUT_MAX);
+    speedctrl_init(Q_FROM_CONST(2.0,10), 0, 0);
+    TEST_EQUAL(speedctrl_update(Q16_FROM_CONST(3000), 0), SPEEDCTRL_OUTPUT_MAX);
+    TEST_EQUAL(speedctrl_update(Q16_FROM_CONST(-3000), 0), -SPEEDCTRL_OUTPUT_MAX);
+    TEST_EQUAL(speedctrl_update(Q16_FROM_CONST(100), Q16_FROM_CONST(10)), 120);
+}
+
+
+// Gains bounded to their safe range : at the bounds, the anti-windup still pulls the integral term back
+static void testGainBounds()
+{
+    speedctrl_setOutputMax(SPEEDCTRL_OUTPUT_MAX);
+    speedctrl_init(-1, -1, INT16_MAX);
+    TEST_EQUAL(speedctrl_getKp(), 0);
+    TEST_EQUAL(speedctrl_getKi(), 0);
+    TEST_EQUAL(speedctrl_getKaw(), SPEEDCTRL_KAW_MAX);
+
+    // Largest excess (command far below the bound) : kaw x excess must not wrap around
+    speedctrl_setKaw(INT16_MAX);
+    TEST_EQUAL(speedctrl_update(Q16_FROM_CONST(-8000), 0), -SPEEDCTRL_OUTPUT_MAX);
+    TEST_CHECK(speedctrl_Integral>0);
+
+    // Largest error and gains : the output follows the error sign
+    speedctrl_setGains(SPEEDCTRL_GAIN_MAX, SPEEDCTRL_GAIN_MAX, INT16_MAX);
+    TEST_EQUAL(speedctrl_update(0, Q16_FROM_CONST(1000)), SPEEDCTRL_OUTPUT_MAX);
+    TEST_EQUAL(speedctrl_update(0, Q16_FROM_CONST(-1000)), -SPEEDCTRL_OUTPUT_MAX);
+}
+
+
+TEST_MAIN(TEST_RUN(testCurrentLimit), TEST_RUN(testDefaultBound), TEST_RUN(testGainBounds))
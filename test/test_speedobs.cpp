@@ -0,0 +1,136 @@
+#include "test.h"
+#include "hal.h"
+#include "hall.h"
+#include "speedobs.h"
+#include "timebase.h"
+#include <math.h>
+
+
+// Hall speed observer fed by a simulated hall edge stream : resolution at constant speed and latency after a step
+
+
+#define TICKS_TO_ROUNDS     48                                      // Hall edges per round (MotorBoard.cpp)
+#define EDGE_ANGLE          (2*M_PI/TICKS_TO_ROUNDS)                // [rad]
+#define CONTROL_CYCLES      (F_CPU/100)                             // Control period (100Hz) [CPU cycles]
+
+// Sensor values ( |H3|H2|H1| ) in the CCW order (the position increases)
+static const uint8_t ccwSequence[6]={ 0b101, 0b100, 0b110, 0b010, 0b011, 0b001 };
+
+// Simulated motor : angle in edges, time of the next edge [CPU cycles]
+static uint8_t motorSector;
+static double motorNextEdge;
+
+
+// Apply the sensor values on the pins (H1 PD7, H2 PD5, H3 PC6) and raise the pin change interrupt
+static void applySensors(uint8_t Sensors)
+{
+    host_setPins(2, ((Sensors & 1)<<7) | (((Sensors>>1) & 1)<<5));
+    host_setPins(1, ((Sensors>>2) & 1)<<6);
+    host_interrupt(PCINT2_vect_num);
+}
+
+
+// Motor at rest on the first sector, observer initialized
+static void setUp()
+{
+    host_reset();
+    timebase_init();
+    motorSector=0;
+    applySensors(ccwSequence[0]);
+    hall_init();
+    speedobs_init(Q16_FROM_CONST(EDGE_ANGLE*TIMEBASE_HZ));
+    sei();
+}
+
+
+// Run the motor at a constant speed [rad.s-1] (CCW if positive, 0 : stopped) up to the next control update
+// The hall edges are applied on time, the update is called at the end
+static q16_t runControlPeriod(double Speed)
+{
+    double End=(double)host_getTime()+CONTROL_CYCLES;
+    double Period=(Speed!=0) ? EDGE_ANGLE/fabs(Speed)*F_CPU : 0;
+    if (Period!=0 && motorNextEdge<=(double)host_getTime()) motorNextEdge=(double)host_getTime()+Period;
+    while (Period!=0 && motorNextEdge<End)
+    {
+        host_advance((uint64_t)motorNextEdge-host_getTime());
+        motorSector=(Speed>0) ? (motorSector+1)%6 : (motorSector+5)%6;
+        applySensors(ccwSequence[motorSector]);
+        motorNextEdge+=Period;
+    }
+    if (Period==0) motorNextEdge=0;
+    host_advance((uint64_t)End-host_getTime());
+    return speedobs_update();
+}
+
+
+// Constant speeds : largest error after the start, against the resolution of the method used
+static void testResolution()
+{
+    static const double speeds[]={ 1.0, 5.0, 20.0, 40.0, 100.0, 363.0, -100.0 };
+    for (uint8_t s=0; s<sizeof(speeds)/sizeof(speeds[0]); s++)
+    {
+        setUp();
+        motorNextEdge=0;
+        double worst=0;
+        double edgePeriods=EDGE_ANGLE/fabs(speeds[s])*100;      // Edge period [control periods]
+        for (uint16_t update=0; update<200+10*edgePeriods; update++)
+        {
+            double estimate=q16_toFloat(runControlPeriod(speeds[s]));
+            if (update<2+3*edgePeriods) continue;               // The first edge period is unknown (direction change)
+            double error=fabs(estimate-speeds[s])/fabs(speeds[s]);
+            if (error>worst) worst=error;
+        }
+
+        // T-method : one timebase tick over the edge period, M-method : one tick over the control period
+        bool mMethod=edgePeriods<=1.0/(SPEEDOBS_M_METHOD_EDGES+1);
+        double resolution=mMethod ? 100.0/TIMEBASE_HZ : fabs(speeds[s])/EDGE_ANGLE/TIMEBASE_HZ;
+        printf("  %7.1f rad/s  %c-method  worst error %.3f%%  resolution %.3f%%\n",
+               speeds[s], mMethod ? 'M' : 'T', 100*worst, 100*resolution);
+        TEST_CHECK(worst<=resolution+0.001);
+    }
+}
+
+
+// Speed step : number of control updates until the estimate is within 2% of the new speed
+static void testStepLatency()
+{
+    static const double steps[][2]={ { 50.0, 100.0 }, { 100.0, 50.0 }, { 5.0, 10.0 }, { 10.0, 5.0 } };
+    for (uint8_t s=0; s<sizeof(steps)/sizeof(steps[0]); s++)
+    {
+        setUp();
+        motorNextEdge=0;
+        for (uint16_t update=0; update<100; update++) runControlPeriod(steps[s][0]);
+        uint8_t latency=0;
+        while (latency<100)
+        {
+            latency++;
+            double estimate=q16_toFloat(runControlPeriod(steps[s][1]));
+            if (fabs(estimate-steps[s][1])<=0.02*steps[s][1]) break;
+        }
+        printf("  %5.1f -> %5.1f rad/s  %u updates\n", steps[s][0], steps[s][1], latency);
+
+        // Within the control period following the first whole edge period at the new speed
+        double edgePeriods=EDGE_ANGLE/steps[s][1]*100;
+        TEST_CHECK(latency<=(uint8_t)ceil(2*edgePeriods)+1);
+    }
+}
+
+
+// Stop : the estimate decays with the time since the last edge and is null after the timeout
+static void testStop()
+{
+    setUp();
+    motorNextEdge=0;
+    for (uint16_t update=0; update<100; update++) runControlPeriod(20.0);
+    q16_t previous=runControlPeriod(0);
+    for (uint8_t update=1; update<SPEEDOBS_TIMEOUT_UPDATES; update++)
+    {
+        q16_t speed=runControlPeriod(0);
+        TEST_CHECK(speed<=previous);
+        previous=speed;
+    }
+    TEST_EQUAL(runControlPeriod(0), 0);
+}
+
+
+TEST_MAIN(TEST_RUN(testResolution), TEST_RUN(testStepLatency), TEST_RUN(testStop))